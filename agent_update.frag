@@ -0,0 +1,52 @@
+#version 330 core
+
+// One fixed step for one agent. State texel: x, velocity x, state, timer.
+// Agents rest, then trot in a random direction for a while, turning around at
+// the ends of the yard. The velocity is kept while resting so the sprite
+// remembers which way it faces.
+out vec4 outState;
+
+uniform sampler2D uState;
+uniform float uDt;
+uniform float uTime;
+
+const float dogMinX = -0.1;
+const float dogMaxX = 1.3;
+const float walkSpeed = 0.12;
+const float STATE_RESTING = 0.0;
+const float STATE_WALKING = 1.0;
+
+float hash(vec2 p) {
+    return fract(sin(dot(p, vec2(12.9898, 78.233))) * 43758.5453);
+}
+
+void main() {
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    vec4 agent = texelFetch(uState, texel, 0);
+    float x = agent.x;
+    float velocity = agent.y;
+    float state = agent.z;
+    float timer = agent.w - uDt;
+
+    // keep the seed small; sin() loses precision on large arguments
+    float roll = hash(vec2(texel) * 0.01 + fract(vec2(uTime * 0.618, uTime * 0.377)) * 100.0);
+
+    if (state == STATE_WALKING) {
+        x += velocity * uDt;
+        if (x < dogMinX || x > dogMaxX) {
+            x = clamp(x, dogMinX, dogMaxX);
+            velocity = -velocity;
+        }
+        if (timer <= 0.0) {
+            state = STATE_RESTING;
+            timer = 1.0 + 3.0 * roll;
+        }
+    }
+    else if (timer <= 0.0) {
+        state = STATE_WALKING;
+        velocity = (roll < 0.5 ? -1.0 : 1.0) * walkSpeed * (0.6 + 0.8 * fract(roll * 7.0));
+        timer = 0.5 + 2.5 * fract(roll * 13.0);
+    }
+
+    outState = vec4(x, velocity, state, timer);
+}
@@ -5,7 +5,10 @@ layout (location = 1) in vec3 aColor;
 
 out vec3 ourColor;
 
+// NDC depth; nearer for things drawn later in painter order
+uniform float uDepth;
+
 void main() {
-    gl_Position = vec4(aPos, 1.0);
+    gl_Position = vec4(aPos.xy, uDepth, 1.0);
     ourColor = aColor; 
 }
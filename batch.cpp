@@ -0,0 +1,184 @@
+#include "batch.h"
+#include "clock.h"
+#include "input_log.h"
+#include "job_system.h"
+#include "pcg.h"
+#include "world.h"
+
+#include <iostream>
+#include <chrono>
+
+using namespace std;
+
+const float scenarioFoodInterval = 2.0f;
+const float scenarioNightInterval = 30.0f;
+// how far the fake clock moves per iteration of the sim-only loop
+const double simOnlyFrameTime = 1.0 / 60.0;
+// food lands this far across the grass either side of the middle
+const float scenarioGrassHalfWidth = 0.95f;
+
+static float randomGrassX(Pcg32& scenario) {
+    return (scenario.unit() * 2.0f - 1.0f) * scenarioGrassHalfWidth;
+}
+
+// Scripted input for step s: food every few seconds at a random spot on the
+// grass and a night toggle now and then.
+unsigned int scenarioInput(World& world, Pcg32& scenario, int s) {
+    static const int foodEvery = (int)(scenarioFoodInterval / simTimestep);
+    static const int nightEvery = (int)(scenarioNightInterval / simTimestep);
+
+    unsigned int keys = 0;
+    if (s > 0 && s % foodEvery == 0) {
+        world.spawnFood(randomGrassX(scenario), -0.7f);
+    }
+    if (s > 0 && s % nightEvery == 0) {
+        keys |= INPUT_TOGGLE_NIGHT;
+    }
+    return keys;
+}
+
+void runScenario(World& world, unsigned int seed, int steps) {
+    Pcg32 scenario(seed);
+    for (int s = 0; s < steps; ++s) {
+        world.step((float)simTimestep, scenarioInput(world, scenario, s));
+    }
+}
+
+BatchResult runWorldBatch(JobSystem& jobs, int worldCount, int dogCount, int steps) {
+    vector<World*> worlds;
+    for (int i = 0; i < worldCount; ++i) {
+        worlds.push_back(new World(dogCount, i + 1));
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    jobs.parallelFor("world", worlds.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            runScenario(*worlds[i], (unsigned int)(i + 1) * 7919u, steps);
+        }
+    });
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    for (size_t i = 0; i < worlds.size(); ++i) {
+        delete worlds[i];
+    }
+
+    BatchResult result;
+    result.worldCount = worldCount;
+    result.stepsPerWorld = steps;
+    result.agentsPerWorld = dogCount;
+    result.threads = jobs.size();
+    result.seconds = seconds;
+    result.worldStepsPerSecond = (double)worldCount * steps / seconds;
+    result.agentStepsPerSecond = result.worldStepsPerSecond * dogCount;
+    return result;
+}
+
+void printBatchResult(const BatchResult& result) {
+    cout << "Batch: " << result.worldCount << " worlds x " << result.stepsPerWorld << " steps, "
+        << result.agentsPerWorld << " dogs each, " << result.threads << " threads" << endl;
+    cout << "  " << result.seconds << " s, " << result.worldStepsPerSecond << " world-steps/s, "
+        << result.agentStepsPerSecond << " agent-steps/s" << endl;
+}
+
+SimOnlyResult runSimOnly(JobSystem& jobs, int dogCount, int birdCount, int foodCount, int ticks) {
+    World world(dogCount, 1, birdCount);
+    world.setJobSystem(&jobs);
+    Pcg32 scenario(7919u);
+    for (int i = 0; i < foodCount; ++i) {
+        world.spawnFood(randomGrassX(scenario), -0.7f);
+    }
+
+    // Same accumulator as the simulation thread, driven by a clock we move by hand.
+    ManualClock clock;
+    FixedStepper stepper(clock, simTimestep);
+
+    SteadyClock wall;
+    int tick = 0;
+    while (tick < ticks) {
+        clock.advance(simOnlyFrameTime);
+        int steps = stepper.stepsDue(maxFrameTime);
+        for (int i = 0; i < steps && tick < ticks; ++i, ++tick) {
+            world.step((float)simTimestep, scenarioInput(world, scenario, tick));
+        }
+    }
+    double seconds = wall.now();
+
+    SimOnlyResult result;
+    result.ticks = ticks;
+    result.dogs = world.dogs.size();
+    result.birds = world.birds.size();
+    result.foodLeft = world.foods.size();
+    result.skippedContacts = world.skippedDogContacts();
+    result.simulatedSeconds = world.time();
+    result.seconds = seconds;
+    result.ticksPerSecond = ticks / seconds;
+    result.nsPerAgentTick = seconds * 1e9 / ((double)ticks * world.agentCount());
+    return result;
+}
+
+void printSimOnlyResult(const SimOnlyResult& result) {
+    cout << "Sim only: " << result.ticks << " ticks (" << result.simulatedSeconds << " s simulated), "
+        << result.dogs << " dogs, " << result.birds << " birds" << endl;
+    cout << "  " << result.seconds << " s, " << result.ticksPerSecond << " ticks/s, "
+        << result.nsPerAgentTick << " ns per agent-tick, " << result.foodLeft << " food left" << endl;
+    if (result.skippedContacts > 0) {
+        cout << "  " << result.skippedContacts << " dog contact candidates over the broadphase budget were not tested"
+            << endl;
+    }
+}
+
+ReplayResult runReplay(JobSystem& jobs, const InputLog& log) {
+    World world(log.dogCount, log.seed, log.birdCount);
+    world.setJobSystem(&jobs);
+    world.buildFlowFieldInBackground();
+    InputPlayer player(log);
+
+    SteadyClock wall;
+    for (unsigned int tick = 0; tick < log.tickCount; ++tick) {
+        world.step((float)simTimestep, player.apply(world, tick));
+    }
+    double seconds = wall.now();
+
+    ReplayResult result;
+    result.ticks = log.tickCount;
+    result.events = log.events.size();
+    result.seconds = seconds;
+    result.ticksPerSecond = log.tickCount / seconds;
+    result.checksum = worldChecksum(world);
+    return result;
+}
+
+void printReplayResult(const ReplayResult& result) {
+    cout << "Replay: " << result.ticks << " ticks, " << result.events << " input events" << endl;
+    cout << "  " << result.seconds << " s, " << result.ticksPerSecond << " ticks/s, checksum "
+        << hex << result.checksum << dec << endl;
+}
+
+// FNV-1a over the raw bytes
+static void hashBytes(unsigned long long& hash, const void* data, size_t size) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+}
+
+template <typename T>
+static void hashArray(unsigned long long& hash, const vector<T>& values) {
+    hashBytes(hash, values.data(), values.size() * sizeof(T));
+}
+
+unsigned long long worldChecksum(const World& world) {
+    unsigned long long hash = 14695981039346656037ull;
+    double time = world.time();
+    hashBytes(hash, &time, sizeof(time));
+    hashArray(hash, world.dogs.posX);
+    hashArray(hash, world.dogs.posY);
+    hashArray(hash, world.dogs.state);
+    hashArray(hash, world.foods.posX);
+    hashArray(hash, world.foods.posY);
+    hashArray(hash, world.foods.state);
+    hashArray(hash, world.zLetters.posX);
+    hashArray(hash, world.birds.posX);
+    hashArray(hash, world.birds.posY);
+    return hash;
+}
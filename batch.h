@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+
+class JobSystem;
+class World;
+struct InputLog;
+
+// Steps many independent worlds in parallel for what-if runs and throughput
+// measurements. Each world gets its own seed and a scripted input scenario
+// (food drops and day/night toggles) derived from that seed.
+struct BatchResult {
+    size_t worldCount;
+    size_t stepsPerWorld;
+    size_t agentsPerWorld;
+    unsigned int threads;
+    double seconds;
+    double worldStepsPerSecond;
+    double agentStepsPerSecond;
+};
+
+BatchResult runWorldBatch(JobSystem& jobs, int worldCount, int dogCount, int steps);
+void printBatchResult(const BatchResult& result);
+
+// One world stepped as fast as possible on the calling thread, with no window
+// or GL context, through the same fixed-step accumulator the interactive loop
+// uses. Measures the cost of the simulation alone; the world's own parallel
+// passes (the bird flock) fan out over jobs. foodCount items are
+// scattered over the grass before the first tick.
+struct SimOnlyResult {
+    size_t ticks;
+    size_t dogs;
+    size_t birds;
+    size_t foodLeft;
+    size_t skippedContacts;
+    double simulatedSeconds;
+    double seconds;
+    double ticksPerSecond;
+    double nsPerAgentTick;
+};
+
+SimOnlyResult runSimOnly(JobSystem& jobs, int dogCount, int birdCount, int foodCount, int ticks);
+void printSimOnlyResult(const SimOnlyResult& result);
+
+// Plays a recorded input log back headless, as fast as possible, through a
+// world set up like the interactive one. The checksum covers every entity's
+// position and state at the end: two runs of the same log (say, before and
+// after an optimisation) must print the same one.
+struct ReplayResult {
+    size_t ticks;
+    size_t events;
+    double seconds;
+    double ticksPerSecond;
+    unsigned long long checksum;
+};
+
+ReplayResult runReplay(JobSystem& jobs, const InputLog& log);
+void printReplayResult(const ReplayResult& result);
+unsigned long long worldChecksum(const World& world);
@@ -0,0 +1,14 @@
+#version 330 core
+
+in vec2 corner;
+out vec4 FragColor;
+
+uniform float uDim;
+
+void main() {
+    // arrowhead pointing along +x: wings swept back from the nose
+    if (abs(corner.y) > 0.5 * (1.0 - corner.x)) {
+        discard;
+    }
+    FragColor = vec4(vec3(0.1) * uDim, 1.0);
+}
@@ -0,0 +1,33 @@
+#version 330 core
+
+// One quad per bird; every per-bird attribute comes from its own instanced buffer.
+layout (location = 0) in vec2 aCorner;
+layout (location = 1) in float aPrevX;
+layout (location = 2) in float aPrevY;
+layout (location = 3) in float aX;
+layout (location = 4) in float aY;
+
+out vec2 corner;
+
+uniform float uAlpha;
+uniform float uSize;
+uniform float uDepth;
+
+void main() {
+    vec2 previous = vec2(aPrevX, aPrevY);
+    vec2 current = vec2(aX, aY);
+    vec2 travel = current - previous;
+
+    // wrapped around the screen edge this step: don't sweep across the sky
+    if (abs(travel.x) > 1.0) {
+        previous = current;
+        travel.x -= sign(travel.x) * 2.0;
+    }
+
+    vec2 forward = length(travel) > 0.0 ? normalize(travel) : vec2(1.0, 0.0);
+    vec2 side = vec2(-forward.y, forward.x);
+    vec2 position = mix(previous, current, uAlpha);
+
+    gl_Position = vec4(position + (forward * aCorner.x + side * aCorner.y) * uSize, uDepth, 1.0);
+    corner = aCorner;
+}
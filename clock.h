@@ -0,0 +1,75 @@
+#pragma once
+
+#include <chrono>
+
+// Time source for the fixed-step loop. Simulation code never asks GLFW or the
+// OS for the time itself, so it runs the same under a window, headless, or
+// under a scripted clock.
+class Clock {
+public:
+    virtual ~Clock() {}
+    virtual double now() const = 0;
+};
+
+// Wall-clock seconds since construction.
+class SteadyClock : public Clock {
+public:
+    SteadyClock() : start(std::chrono::steady_clock::now()) {}
+
+    double now() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point start;
+};
+
+// Clock that only moves when told to, for headless runs and replays.
+class ManualClock : public Clock {
+public:
+    ManualClock() : time(0.0) {}
+
+    double now() const { return time; }
+    void advance(double seconds) { time += seconds; }
+
+private:
+    double time;
+};
+
+// Accumulator that turns clock time into a whole number of fixed steps.
+class FixedStepper {
+public:
+    FixedStepper(const Clock& clock, double step)
+        : clock(clock), step(step), previousTime(clock.now()), accumulator(0.0) {}
+
+    // Steps that became due since the last call. Long stalls are clamped so a
+    // breakpoint or suspend doesn't trigger a burst of catch-up steps.
+    int stepsDue(double maxFrameTime) {
+        double now = clock.now();
+        double frameTime = now - previousTime;
+        previousTime = now;
+        if (frameTime > maxFrameTime) {
+            frameTime = maxFrameTime;
+        }
+        accumulator += frameTime;
+
+        int steps = 0;
+        while (accumulator >= step) {
+            accumulator -= step;
+            ++steps;
+        }
+        return steps;
+    }
+
+    // Clock time at which the most recent due step happened.
+    double lastStepTime() const { return previousTime - accumulator; }
+    double timeUntilNextStep() const { return step - accumulator; }
+    // How far into the next step the clock is, 0..1; the render blend factor.
+    double interpolation() const { return accumulator / step; }
+
+private:
+    const Clock& clock;
+    double step;
+    double previousTime;
+    double accumulator;
+};
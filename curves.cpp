@@ -0,0 +1,96 @@
+#include "curves.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+Curve::Curve()
+    : firstTime(0.0f),
+      lastTime(0.0f),
+      lastValue(0.0f),
+      lastTangent(0.0f),
+      hasKey(false),
+      loop(false) {
+}
+
+Curve& Curve::key(float time, float value, float tangent) {
+    return key(time, value, tangent, tangent);
+}
+
+Curve& Curve::key(float time, float value, float tangentIn, float tangentOut) {
+    if (hasKey) {
+        float duration = time - lastTime;
+        float m0 = lastTangent * duration;
+        float m1 = tangentIn * duration;
+        addSegment(time,
+                   lastValue,
+                   m0,
+                   -3.0f * lastValue - 2.0f * m0 + 3.0f * value - m1,
+                   2.0f * lastValue + m0 - 2.0f * value + m1);
+    }
+    else {
+        firstTime = time;
+        hasKey = true;
+    }
+    lastTime = time;
+    lastValue = value;
+    lastTangent = tangentOut;
+    return *this;
+}
+
+Curve& Curve::bezierTo(float b1, float b2, float time, float value) {
+    float b0 = lastValue;
+    addSegment(time, b0, 3.0f * (b1 - b0), 3.0f * (b0 - 2.0f * b1 + b2), -b0 + 3.0f * b1 - 3.0f * b2 + value);
+    // a key added after this continues along the Bezier's end tangent
+    lastTangent = 3.0f * (value - b2) / (time - lastTime);
+    lastTime = time;
+    lastValue = value;
+    return *this;
+}
+
+Curve& Curve::looping() {
+    loop = true;
+    return *this;
+}
+
+void Curve::addSegment(float endTime, float a, float b, float c, float d) {
+    segmentStart.push_back(lastTime);
+    segmentScale.push_back(1.0f / (endTime - lastTime));
+    c0.push_back(a);
+    c1.push_back(b);
+    c2.push_back(c);
+    c3.push_back(d);
+}
+
+float Curve::sample(float t) const {
+    float value;
+    sample(&t, 1, &value, 1);
+    return value;
+}
+
+void Curve::sample(const float* times, size_t count, float* out, size_t stride) const {
+    size_t segments = segmentStart.size();
+    if (segments == 0) {
+        for (size_t i = 0; i < count; ++i) {
+            out[i * stride] = lastValue;
+        }
+        return;
+    }
+
+    float period = lastTime - firstTime;
+    for (size_t i = 0; i < count; ++i) {
+        float t = times[i];
+        if (loop) {
+            t = firstTime + (t - firstTime) - period * floor((t - firstTime) / period);
+        }
+        t = min(max(t, firstTime), lastTime);
+
+        size_t s = 0;
+        for (size_t k = 1; k < segments; ++k) {
+            s += t >= segmentStart[k];
+        }
+        float u = min((t - segmentStart[s]) * segmentScale[s], 1.0f);
+        out[i * stride] = ((c3[s] * u + c2[s]) * u + c1[s]) * u + c0[s];
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Keyframed animation track: piecewise cubic Hermite (or Bezier) segments.
+// Before the first key and after the last it holds the end values, unless it
+// loops. Segments are kept as polynomial coefficients in separate arrays, so
+// sampling is a segment count, a gather and a Horner step with no branches,
+// and a batch of samples streams through them.
+class Curve {
+public:
+    Curve();
+
+    // Keys go in time order. Tangents are value units per unit of time; a
+    // single tangent is used on both sides of the key.
+    Curve& key(float time, float value, float tangent = 0.0f);
+    Curve& key(float time, float value, float tangentIn, float tangentOut);
+    // Cubic Bezier from the last key to (time, value); c1 and c2 are the
+    // control values at one and two thirds of the way.
+    Curve& bezierTo(float c1, float c2, float time, float value);
+    // Repeat the keys forever; the last key should match the first.
+    Curve& looping();
+
+    float sample(float t) const;
+    // out[i * stride] = sample(times[i]), e.g. one field of an interleaved instance buffer
+    void sample(const float* times, size_t count, float* out, size_t stride) const;
+
+private:
+    void addSegment(float endTime, float c0, float c1, float c2, float c3);
+
+    // segment i covers [segmentStart[i], segmentStart[i + 1]) as c0 + c1 u + c2 u^2 + c3 u^3, u in [0, 1]
+    std::vector<float> segmentStart;
+    std::vector<float> segmentScale;
+    std::vector<float> c0;
+    std::vector<float> c1;
+    std::vector<float> c2;
+    std::vector<float> c3;
+    float firstTime;
+    float lastTime;
+    float lastValue;
+    float lastTangent;
+    bool hasKey;
+    bool loop;
+};
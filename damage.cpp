@@ -0,0 +1,246 @@
+#include "damage.h"
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+using namespace std;
+
+DamageTracker::DamageTracker(int tileSize)
+    : tileSize(tileSize), width(0), height(0), columns(0), rows(0), allDamaged(true), wasFull(false),
+      fractionSum(0.0), frames(0) {
+    damageBounds.x0 = damageBounds.y0 = damageBounds.x1 = damageBounds.y1 = 0;
+}
+
+void DamageTracker::resize(int width, int height) {
+    if (width == this->width && height == this->height) {
+        return;
+    }
+    this->width = width;
+    this->height = height;
+    columns = (width + tileSize - 1) / tileSize;
+    rows = (height + tileSize - 1) / tileSize;
+    current.assign(columns * rows, 0);
+    previous.assign(columns * rows, 0);
+    extra.assign(columns * rows, 0);
+    allDamaged = true;
+}
+
+void DamageTracker::damageAll() {
+    allDamaged = true;
+}
+
+void DamageTracker::markTiles(const PixelRect& rect, vector<unsigned char>& tiles) {
+    int x0 = max(0, rect.x0 / tileSize);
+    int y0 = max(0, rect.y0 / tileSize);
+    int x1 = min(columns, (rect.x1 + tileSize - 1) / tileSize);
+    int y1 = min(rows, (rect.y1 + tileSize - 1) / tileSize);
+    for (int y = y0; y < y1; ++y) {
+        for (int x = x0; x < x1; ++x) {
+            tiles[y * columns + x] = 1;
+        }
+    }
+}
+
+void DamageTracker::add(float minX, float minY, float maxX, float maxY) {
+    // rounded outwards, plus a pixel for antialiased or partly covered edges
+    PixelRect rect;
+    rect.x0 = (int)floor((minX + 1.0f) * 0.5f * width) - 1;
+    rect.y0 = (int)floor((minY + 1.0f) * 0.5f * height) - 1;
+    rect.x1 = (int)ceil((maxX + 1.0f) * 0.5f * width) + 1;
+    rect.y1 = (int)ceil((maxY + 1.0f) * 0.5f * height) + 1;
+    if (rect.x1 > 0 && rect.y1 > 0 && rect.x0 < width && rect.y0 < height) {
+        markTiles(rect, current);
+    }
+}
+
+void DamageTracker::addPixels(const PixelRect& rect) {
+    if (rect.x0 < rect.x1 && rect.y0 < rect.y1) {
+        markTiles(rect, extra);
+    }
+}
+
+void DamageTracker::finish() {
+    damageRects.clear();
+    wasFull = allDamaged;
+    long long damagedTiles = 0;
+
+    if (allDamaged) {
+        PixelRect all = { 0, 0, width, height };
+        damageRects.push_back(all);
+        damagedTiles = (long long)columns * rows;
+        allDamaged = false;
+    }
+    else {
+        // Runs of damaged tiles along each row; a run with the same columns as
+        // one in the row below grows that block upwards instead of starting one.
+        vector<size_t> lastRow;
+        vector<size_t> thisRow;
+        for (int y = 0; y < rows; ++y) {
+            thisRow.clear();
+            int x = 0;
+            while (x < columns) {
+                int i = y * columns + x;
+                if (!(current[i] | previous[i] | extra[i])) {
+                    ++x;
+                    continue;
+                }
+                int start = x;
+                while (x < columns && (current[y * columns + x] | previous[y * columns + x] | extra[y * columns + x])) {
+                    ++x;
+                }
+                damagedTiles += x - start;
+
+                int x0 = start * tileSize;
+                int x1 = min(width, x * tileSize);
+                size_t block = damageRects.size();
+                for (size_t j = 0; j < lastRow.size(); ++j) {
+                    const PixelRect& below = damageRects[lastRow[j]];
+                    if (below.x0 == x0 && below.x1 == x1) {
+                        block = lastRow[j];
+                        break;
+                    }
+                }
+                if (block == damageRects.size()) {
+                    PixelRect rect = { x0, y * tileSize, x1, 0 };
+                    damageRects.push_back(rect);
+                }
+                damageRects[block].y1 = min(height, (y + 1) * tileSize);
+                thisRow.push_back(block);
+            }
+            lastRow.swap(thisRow);
+        }
+    }
+
+    damageBounds.x0 = damageBounds.y0 = damageBounds.x1 = damageBounds.y1 = 0;
+    for (size_t i = 0; i < damageRects.size(); ++i) {
+        const PixelRect& rect = damageRects[i];
+        if (i == 0) {
+            damageBounds = rect;
+            continue;
+        }
+        damageBounds.x0 = min(damageBounds.x0, rect.x0);
+        damageBounds.y0 = min(damageBounds.y0, rect.y0);
+        damageBounds.x1 = max(damageBounds.x1, rect.x1);
+        damageBounds.y1 = max(damageBounds.y1, rect.y1);
+    }
+
+    if (columns > 0 && rows > 0) {
+        fractionSum += (double)damagedTiles / ((double)columns * rows);
+        ++frames;
+    }
+
+    previous.swap(current);
+    fill(current.begin(), current.end(), 0);
+    fill(extra.begin(), extra.end(), 0);
+}
+
+RetainedFrame::RetainedFrame(unsigned int maskShader)
+    : colorTexture(0), depthStencilBuffer(0), framebuffer(0), maskShader(maskShader), width(0), height(0) {
+    glGenVertexArrays(1, &maskVAO);
+    glGenBuffers(1, &maskVBO);
+    glBindVertexArray(maskVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, maskVBO);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+RetainedFrame::~RetainedFrame() {
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &depthStencilBuffer);
+    glDeleteTextures(1, &colorTexture);
+    glDeleteVertexArrays(1, &maskVAO);
+    glDeleteBuffers(1, &maskVBO);
+}
+
+void RetainedFrame::resize(int width, int height) {
+    if (width == this->width && height == this->height) {
+        return;
+    }
+    this->width = width;
+    this->height = height;
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+
+    if (!framebuffer) {
+        glGenTextures(1, &colorTexture);
+        glGenRenderbuffers(1, &depthStencilBuffer);
+        glGenFramebuffers(1, &framebuffer);
+    }
+    glBindTexture(GL_TEXTURE_2D, colorTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, depthStencilBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthStencilBuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        cerr << "Retained frame framebuffer is incomplete" << endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void RetainedFrame::begin(const DamageTracker& damage) {
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, width, height);
+    if (damage.full()) {
+        return;
+    }
+
+    const PixelRect& bounds = damage.bounds();
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(bounds.x0, bounds.y0, bounds.x1 - bounds.x0, bounds.y1 - bounds.y0);
+    const vector<PixelRect>& rects = damage.rects();
+    if (rects.size() <= 1) {
+        return;
+    }
+
+    // stencil 1 inside the damage rectangles, drawn without touching the colour
+    maskVertices.clear();
+    for (size_t i = 0; i < rects.size(); ++i) {
+        float x0 = rects[i].x0 * 2.0f / width - 1.0f;
+        float y0 = rects[i].y0 * 2.0f / height - 1.0f;
+        float x1 = rects[i].x1 * 2.0f / width - 1.0f;
+        float y1 = rects[i].y1 * 2.0f / height - 1.0f;
+        float quad[12] = { x0, y0, x1, y0, x1, y1, x0, y0, x1, y1, x0, y1 };
+        maskVertices.insert(maskVertices.end(), quad, quad + 12);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, maskVBO);
+    glBufferData(GL_ARRAY_BUFFER, maskVertices.size() * sizeof(float), maskVertices.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glClearStencil(0);
+    glClear(GL_STENCIL_BUFFER_BIT);
+    glEnable(GL_STENCIL_TEST);
+    glStencilFunc(GL_ALWAYS, 1, 0xFF);
+    glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glUseProgram(maskShader);
+    glBindVertexArray(maskVAO);
+    glDrawArrays(GL_TRIANGLES, 0, (GLsizei)(maskVertices.size() / 2));
+    glBindVertexArray(0);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+    glStencilFunc(GL_EQUAL, 1, 0xFF);
+    glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+}
+
+void RetainedFrame::present() {
+    glDisable(GL_STENCIL_TEST);
+    // a scissor would clip the blit too
+    glDisable(GL_SCISSOR_TEST);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <vector>
+
+// A rectangle of pixels, origin at the bottom left like GL; empty when x0 >= x1.
+struct PixelRect {
+    int x0, y0, x1, y1;
+};
+
+// Works out which parts of the window have to be redrawn this frame: wherever
+// something was drawn last frame (it may have moved away) or is drawn now.
+// Damage is kept on a coarse grid of tiles and handed out as a few rectangles,
+// neighbouring damaged tiles merged into runs and runs into blocks.
+class DamageTracker {
+public:
+    explicit DamageTracker(int tileSize = 32);
+
+    // Everything is damaged on the next frame after a resize.
+    void resize(int width, int height);
+    // Redraw the whole window this frame.
+    void damageAll();
+    // Something is drawn this frame within this NDC rectangle.
+    void add(float minX, float minY, float maxX, float maxY);
+    // The window changed here this frame, for reasons outside the tracked objects.
+    void addPixels(const PixelRect& rect);
+    // Closes the frame: works out rects() and bounds(), and starts the next frame.
+    void finish();
+
+    const std::vector<PixelRect>& rects() const { return damageRects; }
+    const PixelRect& bounds() const { return damageBounds; }
+    bool full() const { return wasFull; }
+    // share of the window's pixels redrawn, averaged over the frames so far
+    double averageFraction() const { return frames > 0 ? fractionSum / frames : 0.0; }
+
+private:
+    void markTiles(const PixelRect& rect, std::vector<unsigned char>& tiles);
+
+    int tileSize;
+    int width;
+    int height;
+    int columns;
+    int rows;
+    // what this frame draws into, and what the last one did
+    std::vector<unsigned char> current;
+    std::vector<unsigned char> previous;
+    // touched this frame only, no matter what the next one does
+    std::vector<unsigned char> extra;
+    bool allDamaged;
+    bool wasFull;
+    std::vector<PixelRect> damageRects;
+    PixelRect damageBounds;
+    double fractionSum;
+    long long frames;
+};
+
+// The frame is composed in an offscreen colour + depth/stencil target that keeps its
+// contents between frames, so only the damage has to be drawn again; the
+// result is then copied to the window's back buffer, which a swap leaves
+// undefined (GLFW has no portable way to ask for its age). The copy is a
+// plain blit with no shading, far cheaper than redrawing the scene.
+class RetainedFrame {
+public:
+    // maskShader is the damage_mask program; needs a current GL context
+    explicit RetainedFrame(unsigned int maskShader);
+    ~RetainedFrame();
+    RetainedFrame(const RetainedFrame&) = delete;
+    RetainedFrame& operator=(const RetainedFrame&) = delete;
+
+    void resize(int width, int height);
+    // Binds the frame and limits drawing to the damage: a scissor around all
+    // of it and, when it's several rectangles, a stencil mask of them.
+    void begin(const DamageTracker& damage);
+    // Switches back to the window and copies the frame into its back buffer.
+    void present();
+    // for other framebuffers that draw against the frame's depth
+    unsigned int depthStencil() const { return depthStencilBuffer; }
+
+private:
+    unsigned int colorTexture;
+    // depth + stencil: the combination every GL 3.3 driver supports
+    unsigned int depthStencilBuffer;
+    unsigned int framebuffer;
+    unsigned int maskShader;
+    unsigned int maskVAO;
+    unsigned int maskVBO;
+    std::vector<float> maskVertices;
+    int width;
+    int height;
+};
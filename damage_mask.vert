@@ -0,0 +1,8 @@
+#version 330 core
+
+// Damage rectangles, already in NDC; only the stencil is written.
+layout(location = 0) in vec2 aPos;
+
+void main() {
+    gl_Position = vec4(aPos, 0.0, 1.0);
+}
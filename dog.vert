@@ -2,23 +2,43 @@
 
 layout (location = 0) in vec3 aPos;   
 layout (location = 1) in vec3 aColor; 
+// per CPU dog: position already interpolated, and 1 when it faces the other way
+layout (location = 2) in vec3 aInstance;
 
 out vec3 ourColor;
 
-uniform vec2 uPos;   
-uniform bool uFlip;  
+// GPU agent path: offset and facing come from the agent state textures
+// (x, velocity x, state, timer), one texel per instance
+uniform bool uFromState;
+uniform sampler2D uPrevState;
+uniform sampler2D uState;
+uniform float uAlpha;
+uniform float uDepth;
 
 const vec2 dogCenter = vec2(-0.65, -0.68);
 
 void main() {
     vec3 newPosition = aPos;
+    vec2 offset = aInstance.xy;
+    bool flip = aInstance.z != 0.0;
+
+    if (uFromState) {
+        int width = textureSize(uState, 0).x;
+        ivec2 texel = ivec2(gl_InstanceID % width, gl_InstanceID / width);
+        vec4 previous = texelFetch(uPrevState, texel, 0);
+        vec4 current = texelFetch(uState, texel, 0);
+        // spread the pack over the depth of the lawn so they don't all stand on one line
+        float row = fract(float(gl_InstanceID) * 0.7548777);
+        offset = vec2(mix(previous.x, current.x, uAlpha), -0.1 * row);
+        flip = current.y < 0.0;
+    }
 
-    if (uFlip) {
+    if (flip) {
         newPosition.x = 2.0 * dogCenter.x - newPosition.x;
     }
 
-    newPosition += vec3(uPos, 0.0);
+    newPosition += vec3(offset, 0.0);
 
-    gl_Position = vec4(newPosition, 1.0);
+    gl_Position = vec4(newPosition.xy, uDepth, 1.0);
     ourColor = aColor; 
 }
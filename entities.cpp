@@ -0,0 +1,120 @@
+#include "entities.h"
+
+static const unsigned int SLOT_BITS = 22;
+static const unsigned int SLOT_MASK = (1u << SLOT_BITS) - 1;
+static const unsigned int GENERATION_MASK = (1u << (32 - SLOT_BITS)) - 1;
+
+static unsigned int slotOf(EntityId id) { return id & SLOT_MASK; }
+static unsigned int generationOf(EntityId id) { return id >> SLOT_BITS; }
+
+EntityId EntityPool::create(float x, float y) {
+    unsigned int slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else {
+        slot = (unsigned int)denseIndex.size();
+        denseIndex.push_back(0);
+        generations.push_back(0);
+    }
+
+    EntityId id = (generations[slot] << SLOT_BITS) | slot;
+    denseIndex[slot] = (unsigned int)ids.size();
+    ids.push_back(id);
+
+    posX.push_back(x);
+    posY.push_back(y);
+    prevX.push_back(x);
+    prevY.push_back(y);
+    velX.push_back(0.0f);
+    velY.push_back(0.0f);
+    state.push_back(0);
+    timer.push_back(0.0f);
+    param.push_back(0.0f);
+    sprite.push_back(0);
+    link.push_back(INVALID_ENTITY);
+    return id;
+}
+
+void EntityPool::destroy(EntityId id) {
+    if (alive(id)) {
+        destroyAt(denseIndex[slotOf(id)]);
+    }
+}
+
+void EntityPool::destroyAt(size_t index) {
+    size_t last = ids.size() - 1;
+    unsigned int slot = slotOf(ids[index]);
+
+    if (index != last) {
+        posX[index] = posX[last];
+        posY[index] = posY[last];
+        prevX[index] = prevX[last];
+        prevY[index] = prevY[last];
+        velX[index] = velX[last];
+        velY[index] = velY[last];
+        state[index] = state[last];
+        timer[index] = timer[last];
+        param[index] = param[last];
+        sprite[index] = sprite[last];
+        link[index] = link[last];
+        ids[index] = ids[last];
+        denseIndex[slotOf(ids[index])] = (unsigned int)index;
+    }
+
+    posX.pop_back();
+    posY.pop_back();
+    prevX.pop_back();
+    prevY.pop_back();
+    velX.pop_back();
+    velY.pop_back();
+    state.pop_back();
+    timer.pop_back();
+    param.pop_back();
+    sprite.pop_back();
+    link.pop_back();
+    ids.pop_back();
+
+    generations[slot] = (generations[slot] + 1) & GENERATION_MASK;
+    freeSlots.push_back(slot);
+}
+
+void EntityPool::clear() {
+    while (!ids.empty()) {
+        destroyAt(ids.size() - 1);
+    }
+}
+
+void EntityPool::reserve(size_t count) {
+    posX.reserve(count);
+    posY.reserve(count);
+    prevX.reserve(count);
+    prevY.reserve(count);
+    velX.reserve(count);
+    velY.reserve(count);
+    state.reserve(count);
+    timer.reserve(count);
+    param.reserve(count);
+    sprite.reserve(count);
+    link.reserve(count);
+    ids.reserve(count);
+}
+
+bool EntityPool::alive(EntityId id) const {
+    if (id == INVALID_ENTITY) {
+        return false;
+    }
+    unsigned int slot = slotOf(id);
+    return slot < generations.size() && generations[slot] == generationOf(id)
+        && denseIndex[slot] < ids.size() && ids[denseIndex[slot]] == id;
+}
+
+size_t EntityPool::indexOf(EntityId id) const {
+    return denseIndex[slotOf(id)];
+}
+
+void EntityPool::storePreviousPositions() {
+    prevX.assign(posX.begin(), posX.end());
+    prevY.assign(posY.begin(), posY.end());
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Stable handle to an entity. The low bits index the id slot, the high bits
+// are a generation counter so a handle to a removed entity never aliases a
+// newer one that reused its slot.
+typedef unsigned int EntityId;
+const EntityId INVALID_ENTITY = 0xFFFFFFFFu;
+
+// Structure-of-arrays storage for one kind of entity (dogs, food, Z letters,
+// smoke). Every component lives in its own packed array indexed by the dense
+// entity index, so update passes stream through only the fields they touch.
+// Removal swaps the last entity into the hole; dense indices are therefore not
+// stable across removals, ids are.
+class EntityPool {
+public:
+    // position and the position at the start of the current step (for interpolation)
+    std::vector<float> posX;
+    std::vector<float> posY;
+    std::vector<float> prevX;
+    std::vector<float> prevY;
+    std::vector<float> velX;
+    std::vector<float> velY;
+    std::vector<unsigned char> state;
+    std::vector<float> timer;
+    // per-kind scalar, e.g. a dog's home x
+    std::vector<float> param;
+    // sprite flags, e.g. SPRITE_FLIP for a dog facing left
+    std::vector<unsigned char> sprite;
+    // per-kind reference to another entity, e.g. the food a dog walks to
+    std::vector<EntityId> link;
+
+    size_t size() const { return ids.size(); }
+    bool empty() const { return ids.empty(); }
+
+    EntityId create(float x, float y);
+    void destroy(EntityId id);
+    void destroyAt(size_t index);
+    void clear();
+    void reserve(size_t count);
+
+    bool alive(EntityId id) const;
+    size_t indexOf(EntityId id) const;
+    EntityId idAt(size_t index) const { return ids[index]; }
+
+    // prev = pos for every entity, called once at the start of a step
+    void storePreviousPositions();
+
+private:
+    std::vector<EntityId> ids;
+    std::vector<unsigned int> denseIndex;
+    std::vector<unsigned int> generations;
+    std::vector<unsigned int> freeSlots;
+};
+
+const unsigned char SPRITE_FLIP = 1;
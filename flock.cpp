@@ -0,0 +1,199 @@
+#include "flock.h"
+#include "job_system.h"
+#include "pcg.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+// The sky is the top half of the screen; birds wrap left/right and are turned back at the top and bottom.
+const float skyMinX = -1.0f;
+const float skyMaxX = 1.0f;
+const float skyMinY = 0.05f;
+const float skyMaxY = 0.95f;
+const float perceptionRadius = 0.03f;
+const float separationRadius = 0.012f;
+const float separationWeight = 1.5f;
+const float alignmentWeight = 1.0f;
+const float cohesionWeight = 6.0f;
+const float edgeTurnWeight = 2.0f;
+const float edgeMargin = 0.08f;
+const float birdMinSpeed = 0.12f;
+const float birdMaxSpeed = 0.3f;
+// normalises the soft separation push to roughly unit strength at half the radius
+const float separationScale = 1.0f / (separationRadius * separationRadius * separationRadius);
+// steering is split into jobs of this many birds
+const size_t birdsPerJob = 2048;
+
+Flock::Flock(int birdCount, unsigned int seed) {
+    cellsX = (int)ceil((skyMaxX - skyMinX) / perceptionRadius);
+    cellsY = (int)ceil((skyMaxY - skyMinY) / perceptionRadius);
+    cellStart.assign(cellsX * cellsY + 1, 0);
+
+    Pcg32 rng(seed);
+    for (int i = 0; i < birdCount; ++i) {
+        float x = skyMinX + (skyMaxX - skyMinX) * rng.unit();
+        float y = skyMinY + (skyMaxY - skyMinY) * rng.unit();
+        float angle = 6.2831853f * rng.unit();
+        float speed = birdMinSpeed + (birdMaxSpeed - birdMinSpeed) * rng.unit();
+        posX.push_back(x);
+        posY.push_back(y);
+        prevX.push_back(x);
+        prevY.push_back(y);
+        velX.push_back(cos(angle) * speed);
+        velY.push_back(sin(angle) * speed);
+    }
+    birdCell.resize(birdCount);
+    order.resize(birdCount);
+    nextVelX.resize(birdCount);
+    nextVelY.resize(birdCount);
+}
+
+int Flock::cellOf(float x, float y) const {
+    int cx = max(0, min((int)((x - skyMinX) / perceptionRadius), cellsX - 1));
+    int cy = max(0, min((int)((y - skyMinY) / perceptionRadius), cellsY - 1));
+    return cy * cellsX + cx;
+}
+
+void Flock::sortIntoCells(JobSystem* jobs) {
+    size_t count = size();
+    fill(cellStart.begin(), cellStart.end(), 0);
+    for (size_t i = 0; i < count; ++i) {
+        birdCell[i] = cellOf(posX[i], posY[i]);
+        ++cellStart[birdCell[i] + 1];
+    }
+    for (size_t c = 1; c < cellStart.size(); ++c) {
+        cellStart[c] += cellStart[c - 1];
+    }
+
+    // cellStart[c] doubles as the write cursor for cell c while scattering;
+    // afterwards it points at the end of c, which is the start of c + 1.
+    for (size_t i = 0; i < count; ++i) {
+        order[cellStart[birdCell[i]]++] = (unsigned int)i;
+    }
+    for (size_t c = cellStart.size() - 1; c > 0; --c) {
+        cellStart[c] = cellStart[c - 1];
+    }
+    cellStart[0] = 0;
+
+    // each array is gathered through its own scratch buffer so they can go in parallel
+    vector<float>* arrays[] = { &posX, &posY, &prevX, &prevY, &velX, &velY };
+    auto permute = [&](size_t begin, size_t end) {
+        for (size_t a = begin; a < end; ++a) {
+            vector<float>& values = *arrays[a];
+            vector<float>& gathered = scratch[a];
+            gathered.resize(count);
+            for (size_t i = 0; i < count; ++i) {
+                gathered[i] = values[order[i]];
+            }
+            values.swap(gathered);
+        }
+    };
+    if (jobs) {
+        jobs->parallelFor("birds.sort", 6, 1, permute);
+    }
+    else {
+        permute(0, 6);
+    }
+}
+
+void Flock::steerRange(size_t begin, size_t end, float dt) {
+    const float perceptionSq = perceptionRadius * perceptionRadius;
+    const float separationSq = separationRadius * separationRadius;
+    const float* px = posX.data();
+    const float* py = posY.data();
+    const float* vx = velX.data();
+    const float* vy = velY.data();
+
+    for (size_t i = begin; i < end; ++i) {
+        float x = px[i];
+        float y = py[i];
+        int cell = cellOf(x, y);
+        int cx = cell % cellsX;
+        int cy = cell / cellsX;
+
+        float neighbours = 0.0f;
+        float sumX = 0.0f, sumY = 0.0f;
+        float sumVelX = 0.0f, sumVelY = 0.0f;
+        float pushX = 0.0f, pushY = 0.0f;
+
+        for (int ny = max(cy - 1, 0); ny <= min(cy + 1, cellsY - 1); ++ny) {
+            // the three cells of a row are adjacent in the sorted arrays: one run
+            int rowStart = ny * cellsX;
+            unsigned int first = cellStart[rowStart + max(cx - 1, 0)];
+            unsigned int last = cellStart[rowStart + min(cx + 1, cellsX - 1) + 1];
+
+            // Branch-free body over contiguous arrays. The bird itself is in the
+            // run; dx = dy = 0 keeps it out of every sum but the velocity one.
+            for (unsigned int j = first; j < last; ++j) {
+                float dx = px[j] - x;
+                float dy = py[j] - y;
+                float distanceSq = dx * dx + dy * dy;
+                float inRange = (float)(distanceSq < perceptionSq);
+                // soft push that fades to zero at the separation radius
+                float push = max(separationSq - distanceSq, 0.0f);
+                neighbours += inRange;
+                sumX += inRange * dx;
+                sumY += inRange * dy;
+                sumVelX += inRange * vx[j];
+                sumVelY += inRange * vy[j];
+                pushX -= push * dx;
+                pushY -= push * dy;
+            }
+        }
+
+        float others = neighbours - 1.0f;
+
+        float steerX = 0.0f;
+        float steerY = 0.0f;
+        if (others > 0.0f) {
+            float inverse = 1.0f / others;
+            steerX += cohesionWeight * sumX * inverse;
+            steerY += cohesionWeight * sumY * inverse;
+            steerX += alignmentWeight * ((sumVelX - vx[i]) * inverse - vx[i]);
+            steerY += alignmentWeight * ((sumVelY - vy[i]) * inverse - vy[i]);
+            steerX += separationWeight * pushX * separationScale;
+            steerY += separationWeight * pushY * separationScale;
+        }
+        if (y < skyMinY + edgeMargin) steerY += edgeTurnWeight * birdMaxSpeed;
+        if (y > skyMaxY - edgeMargin) steerY -= edgeTurnWeight * birdMaxSpeed;
+
+        float newVelX = vx[i] + steerX * dt;
+        float newVelY = vy[i] + steerY * dt;
+        float speed = sqrt(newVelX * newVelX + newVelY * newVelY);
+        float limited = max(birdMinSpeed, min(speed, birdMaxSpeed));
+        float scale = speed > 0.0f ? limited / speed : 0.0f;
+        nextVelX[i] = newVelX * scale;
+        nextVelY[i] = newVelY * scale;
+    }
+}
+
+void Flock::step(float dt, JobSystem* jobs) {
+    if (posX.empty()) {
+        return;
+    }
+
+    sortIntoCells(jobs);
+    if (jobs) {
+        jobs->parallelFor("birds.steer", size(), birdsPerJob, [this, dt](size_t begin, size_t end) {
+            steerRange(begin, end, dt);
+        });
+    }
+    else {
+        steerRange(0, size(), dt);
+    }
+
+    size_t count = size();
+    velX.swap(nextVelX);
+    velY.swap(nextVelY);
+    for (size_t i = 0; i < count; ++i) {
+        prevX[i] = posX[i];
+        prevY[i] = posY[i];
+        posX[i] += velX[i] * dt;
+        posY[i] += velY[i] * dt;
+        if (posX[i] < skyMinX) posX[i] += skyMaxX - skyMinX;
+        if (posX[i] >= skyMaxX) posX[i] -= skyMaxX - skyMinX;
+        posY[i] = max(skyMinY, min(posY[i], skyMaxY));
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+class JobSystem;
+
+// Boids over the sky: separation, alignment and cohesion against every bird
+// within perception range. Birds are stored structure-of-arrays and re-sorted
+// by grid cell with a counting sort at the start of every step, so each cell's
+// birds are contiguous and a neighbour scan is a handful of linear runs over
+// the position and velocity arrays. Bird order is not stable between steps.
+class Flock {
+public:
+    Flock(int birdCount, unsigned int seed);
+
+    // jobs may be null; otherwise the sort and steering passes are split across it
+    void step(float dt, JobSystem* jobs);
+
+    size_t size() const { return posX.size(); }
+
+    std::vector<float> posX;
+    std::vector<float> posY;
+    std::vector<float> prevX;
+    std::vector<float> prevY;
+    std::vector<float> velX;
+    std::vector<float> velY;
+
+private:
+    void sortIntoCells(JobSystem* jobs);
+    void steerRange(size_t begin, size_t end, float dt);
+    int cellOf(float x, float y) const;
+
+    int cellsX;
+    int cellsY;
+    // birds in cell c are [cellStart[c], cellStart[c + 1])
+    std::vector<unsigned int> cellStart;
+    std::vector<unsigned int> birdCell;
+    std::vector<unsigned int> order;
+    std::vector<float> scratch[6];
+    std::vector<float> nextVelX;
+    std::vector<float> nextVelY;
+};
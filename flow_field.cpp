@@ -0,0 +1,158 @@
+#include "flow_field.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+static const float unreachable = 1e30f;
+static const float diagonalCost = 1.41421356f;
+
+FlowField::FlowField(float minX, float minY, float maxX, float maxY, float cellSize)
+    : minX(minX), minY(minY), cellSize(cellSize), hasGoals(false) {
+    width = (int)ceil((maxX - minX) / cellSize);
+    height = (int)ceil((maxY - minY) / cellSize);
+    integration.assign(width * height, unreachable);
+    dirX.assign(width * height, 0.0f);
+    dirY.assign(width * height, 0.0f);
+}
+
+int FlowField::cellIndex(float x, float y) const {
+    int cx = (int)floor((x - minX) / cellSize);
+    int cy = (int)floor((y - minY) / cellSize);
+    if (cx < 0 || cy < 0 || cx >= width || cy >= height) {
+        return -1;
+    }
+    return cy * width + cx;
+}
+
+void FlowField::build(const vector<float>& goalX, const vector<float>& goalY) {
+    integration.assign(width * height, unreachable);
+    hasGoals = false;
+    for (size_t i = 0; i < goalX.size(); ++i) {
+        int cell = cellIndex(goalX[i], goalY[i]);
+        if (cell >= 0) {
+            integration[cell] = 0.0f;
+            hasGoals = true;
+        }
+    }
+
+    // forward pass pulls distances from the left and the row above
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            float& d = integration[y * width + x];
+            if (x > 0) d = min(d, integration[y * width + x - 1] + 1.0f);
+            if (y > 0) {
+                d = min(d, integration[(y - 1) * width + x] + 1.0f);
+                if (x > 0) d = min(d, integration[(y - 1) * width + x - 1] + diagonalCost);
+                if (x + 1 < width) d = min(d, integration[(y - 1) * width + x + 1] + diagonalCost);
+            }
+        }
+    }
+    // backward pass from the right and the row below
+    for (int y = height - 1; y >= 0; --y) {
+        for (int x = width - 1; x >= 0; --x) {
+            float& d = integration[y * width + x];
+            if (x + 1 < width) d = min(d, integration[y * width + x + 1] + 1.0f);
+            if (y + 1 < height) {
+                d = min(d, integration[(y + 1) * width + x] + 1.0f);
+                if (x + 1 < width) d = min(d, integration[(y + 1) * width + x + 1] + diagonalCost);
+                if (x > 0) d = min(d, integration[(y + 1) * width + x - 1] + diagonalCost);
+            }
+        }
+    }
+
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            int cell = y * width + x;
+            float best = integration[cell];
+            int bestDx = 0;
+            int bestDy = 0;
+            for (int dy = -1; dy <= 1; ++dy) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                    int nx = x + dx;
+                    int ny = y + dy;
+                    if ((dx == 0 && dy == 0) || nx < 0 || ny < 0 || nx >= width || ny >= height) {
+                        continue;
+                    }
+                    if (integration[ny * width + nx] < best) {
+                        best = integration[ny * width + nx];
+                        bestDx = dx;
+                        bestDy = dy;
+                    }
+                }
+            }
+            float length = (bestDx != 0 && bestDy != 0) ? diagonalCost : 1.0f;
+            dirX[cell] = bestDx / length;
+            dirY[cell] = bestDy / length;
+        }
+    }
+}
+
+void FlowField::direction(float x, float y, float& outX, float& outY) const {
+    // points off the grid steer as if they stood on the nearest edge cell
+    int cx = std::max(0, std::min(width - 1, (int)floor((x - minX) / cellSize)));
+    int cy = std::max(0, std::min(height - 1, (int)floor((y - minY) / cellSize)));
+    outX = dirX[cy * width + cx];
+    outY = dirY[cy * width + cx];
+}
+
+FlowFieldWorker::FlowFieldWorker(const FlowField& layout)
+    : running(true), hasRequest(false), isBuilding(false), hasResult(false), building(layout), result(layout) {
+    worker = thread(&FlowFieldWorker::workerMain, this);
+}
+
+FlowFieldWorker::~FlowFieldWorker() {
+    {
+        lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+    wake.notify_one();
+    worker.join();
+}
+
+void FlowFieldWorker::request(const vector<float>& goalX, const vector<float>& goalY) {
+    {
+        lock_guard<std::mutex> lock(mutex);
+        requestX = goalX;
+        requestY = goalY;
+        hasRequest = true;
+    }
+    wake.notify_one();
+}
+
+bool FlowFieldWorker::waitForResult(FlowField& field) {
+    unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this] { return !hasRequest && !isBuilding; });
+    if (!hasResult) {
+        return false;
+    }
+    swap(field, result);
+    hasResult = false;
+    return true;
+}
+
+void FlowFieldWorker::workerMain() {
+    vector<float> goalX;
+    vector<float> goalY;
+    unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this] { return hasRequest || !running; });
+        if (!running) {
+            return;
+        }
+        goalX.swap(requestX);
+        goalY.swap(requestY);
+        hasRequest = false;
+        isBuilding = true;
+
+        lock.unlock();
+        building.build(goalX, goalY);
+        lock.lock();
+
+        swap(result, building);
+        hasResult = true;
+        isBuilding = false;
+        finished.notify_all();
+    }
+}
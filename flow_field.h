@@ -0,0 +1,67 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Grid of steering directions toward the nearest goal. build() runs a
+// two-pass chamfer distance transform from the goal cells (the integration
+// field), then points every cell at its lowest neighbour (the direction
+// field). Agents sample their direction in O(1), however many goals there are.
+class FlowField {
+public:
+    FlowField(float minX, float minY, float maxX, float maxY, float cellSize);
+
+    void build(const std::vector<float>& goalX, const std::vector<float>& goalY);
+
+    // Unit step toward the nearest goal; zero on a goal cell or when there are
+    // no goals. Points outside the grid read the nearest edge cell.
+    void direction(float x, float y, float& dirX, float& dirY) const;
+
+    bool ready() const { return hasGoals; }
+
+private:
+    int cellIndex(float x, float y) const;
+
+    float minX;
+    float minY;
+    float cellSize;
+    int width;
+    int height;
+    bool hasGoals;
+    std::vector<float> integration;
+    std::vector<float> dirX;
+    std::vector<float> dirY;
+};
+
+// Builds flow fields on a thread of its own. A new request replaces one that
+// hasn't started yet, so a burst of goal changes costs one rebuild.
+class FlowFieldWorker {
+public:
+    explicit FlowFieldWorker(const FlowField& layout);
+    ~FlowFieldWorker();
+
+    void request(const std::vector<float>& goalX, const std::vector<float>& goalY);
+    // Waits for every request so far to be built and swaps the newest field
+    // into field; false if nothing was requested since the last call. Taking
+    // results at fixed points of the simulation (rather than whenever the
+    // worker happens to finish) keeps runs repeatable.
+    bool waitForResult(FlowField& field);
+
+private:
+    void workerMain();
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    bool running;
+    bool hasRequest;
+    bool isBuilding;
+    bool hasResult;
+    std::vector<float> requestX;
+    std::vector<float> requestY;
+    FlowField building;
+    FlowField result;
+};
@@ -1,14 +1,17 @@
 #version 330 core
 layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec3 aColor;
+// per item: where it is, already interpolated
+layout(location = 2) in vec2 aOffset;
 
-uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
+uniform float uDepth;
 
 out vec3 ourColor;
 
 void main() {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = projection * view * vec4(aPos + vec3(aOffset, 0.0), 1.0);
+    gl_Position.z = uDepth * gl_Position.w;
     ourColor = aColor;
 }
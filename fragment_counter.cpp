@@ -0,0 +1,78 @@
+#include "fragment_counter.h"
+
+#include <GL/glew.h>
+#include <iostream>
+
+using namespace std;
+
+// frames a query waits before it's read: more than can be in flight
+const int querySlots = 4;
+
+FragmentCounter::FragmentCounter(int passCount)
+    : passCount(passCount), slot(0), queries(querySlots * passCount), issued(querySlots * passCount, 0),
+      sums(passCount, 0.0), runs(passCount, 0), frames(0) {
+    glGenQueries((GLsizei)queries.size(), queries.data());
+}
+
+FragmentCounter::~FragmentCounter() {
+    glDeleteQueries((GLsizei)queries.size(), queries.data());
+}
+
+void FragmentCounter::beginPass(int pass) {
+    int index = slot * passCount + pass;
+    glBeginQuery(GL_SAMPLES_PASSED, queries[index]);
+    issued[index] = 1;
+}
+
+void FragmentCounter::endPass() {
+    glEndQuery(GL_SAMPLES_PASSED);
+}
+
+void FragmentCounter::collect(int slot) {
+    bool any = false;
+    for (int pass = 0; pass < passCount; ++pass) {
+        int index = slot * passCount + pass;
+        if (!issued[index]) {
+            continue;
+        }
+        GLuint samples = 0;
+        glGetQueryObjectuiv(queries[index], GL_QUERY_RESULT, &samples);
+        sums[pass] += samples;
+        if (samples > 0) {
+            ++runs[pass];
+        }
+        issued[index] = 0;
+        any = true;
+    }
+    if (any) {
+        ++frames;
+    }
+}
+
+void FragmentCounter::endFrame() {
+    slot = (slot + 1) % querySlots;
+    // the oldest frame's queries, about to be reused
+    collect(slot);
+}
+
+double FragmentCounter::average(int pass) const {
+    return runs[pass] > 0 ? sums[pass] / runs[pass] : 0.0;
+}
+
+double FragmentCounter::averageFrame() const {
+    double total = 0.0;
+    for (int pass = 0; pass < passCount; ++pass) {
+        total += sums[pass];
+    }
+    return frames > 0 ? total / frames : 0.0;
+}
+
+void FragmentCounter::print(const char* label, const char* const* passNames) const {
+    cout << label << ": " << (long long)averageFrame() << " per frame over " << frames << " frames (per run:";
+    for (int pass = 0; pass < passCount; ++pass) {
+        if (runs[pass] > 0) {
+            cout << " " << passNames[pass] << " " << (long long)average(pass);
+        }
+    }
+    cout << ")" << endl;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+
+// Counts the samples each pass of a frame writes, with one GL_SAMPLES_PASSED
+// query per pass. That's every fragment that survives the depth and stencil
+// tests, which with early-Z is every fragment that gets shaded. Queries are
+// read back a few frames after they ran, by which time the GPU is done with
+// them, so counting never stalls the CPU.
+class FragmentCounter {
+public:
+    // needs a current GL context
+    explicit FragmentCounter(int passCount);
+    ~FragmentCounter();
+    FragmentCounter(const FragmentCounter&) = delete;
+    FragmentCounter& operator=(const FragmentCounter&) = delete;
+
+    // Counts draws in between into pass; passes can't nest.
+    void beginPass(int pass);
+    void endPass();
+    // After the frame's last pass.
+    void endFrame();
+
+    // samples per run of pass that drew anything, over the frames read back so
+    // far; passes that don't run every frame (a layer redraw) aren't diluted
+    // by the ones they skip
+    double average(int pass) const;
+    // samples per frame, all passes together
+    double averageFrame() const;
+    // e.g. "Fragments: 123456 per frame (sky 1000, dogs 2000, ...)"
+    void print(const char* label, const char* const* passNames) const;
+
+private:
+    void collect(int slot);
+
+    int passCount;
+    int slot;
+    // [slot * passCount + pass]; a slot is a frame still in flight
+    std::vector<unsigned int> queries;
+    std::vector<unsigned char> issued;
+    std::vector<double> sums;
+    std::vector<long long> runs;
+    long long frames;
+};
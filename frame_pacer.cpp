@@ -0,0 +1,78 @@
+#include "frame_pacer.h"
+#include "clock.h"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+using namespace std;
+
+// sleep_for overshoots by up to a scheduler tick; the last bit is spent yielding
+const double spinMargin = 0.001;
+// extra room on top of the estimate for frames that take a little longer than usual
+const double buildMargin = 0.0015;
+const double estimateSmoothing = 0.1;
+// don't hang forever on a lost context or a hung driver
+const GLuint64 fenceTimeout = 100000000; // 100 ms in ns
+
+FramePacer::FramePacer(const Clock& clock, double targetFps, int maxFramesInFlight)
+    : clock(clock),
+      period(targetFps > 0.0 ? 1.0 / targetFps : 0.0),
+      maxFramesInFlight(std::max(1, maxFramesInFlight)),
+      deadline(0.0),
+      frameStart(0.0),
+      lastFrameStart(-1.0),
+      buildEstimate(0.0) {
+    deadline = clock.now();
+}
+
+FramePacer::~FramePacer() {
+    for (size_t i = 0; i < fences.size(); ++i) {
+        glDeleteSync(fences[i]);
+    }
+}
+
+void FramePacer::waitForFrameStart() {
+    if (period > 0.0) {
+        deadline += period;
+        double now = clock.now();
+        // more than a frame behind: start over from now instead of rushing to catch up
+        if (deadline < now) {
+            deadline = now + period;
+        }
+
+        double wakeAt = deadline - buildEstimate - buildMargin;
+        if (wakeAt - now > spinMargin) {
+            this_thread::sleep_for(chrono::duration<double>(wakeAt - now - spinMargin));
+        }
+        while (clock.now() < wakeAt) {
+            this_thread::yield();
+        }
+    }
+
+    frameStart = clock.now();
+    if (lastFrameStart >= 0.0) {
+        intervals.add(frameStart - lastFrameStart);
+    }
+    lastFrameStart = frameStart;
+}
+
+void FramePacer::frameBuilt() {
+    double build = clock.now() - frameStart;
+    buildEstimate = buildEstimate == 0.0 ? build : buildEstimate + (build - buildEstimate) * estimateSmoothing;
+}
+
+void FramePacer::frameSubmitted() {
+    fences.push_back(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+    while ((int)fences.size() > maxFramesInFlight) {
+        glClientWaitSync(fences.front(), GL_SYNC_FLUSH_COMMANDS_BIT, fenceTimeout);
+        glDeleteSync(fences.front());
+        fences.pop_front();
+    }
+}
+
+void FramePacer::idled() {
+    lastFrameStart = -1.0;
+}
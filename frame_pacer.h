@@ -0,0 +1,46 @@
+#pragma once
+
+#include <deque>
+#include "latency_stats.h"
+
+class Clock;
+typedef struct __GLsync* GLsync;
+
+// Paces the render loop to a target frame rate and bounds how far the CPU can
+// run ahead of the GPU. Each frame has a deadline one period after the last;
+// the pacer sleeps until the deadline minus how long a frame has recently
+// taken to build, so the frame is done just in time and the input it sampled
+// is as fresh as it can be. After each swap a fence goes into the GL stream,
+// and once more than maxFramesInFlight are outstanding the oldest is waited
+// on, so the driver can't queue up frames (and their latency) on its own.
+class FramePacer {
+public:
+    // targetFps 0 leaves the rate to the swap interval and only caps frames in flight.
+    FramePacer(const Clock& clock, double targetFps, int maxFramesInFlight);
+    ~FramePacer();
+
+    // Top of the frame: sleeps until it is time to start building it.
+    void waitForFrameStart();
+    // Just before the swap, which may block on vsync and must not count as build time.
+    void frameBuilt();
+    // Right after the swap; needs the GL context.
+    void frameSubmitted();
+    // The loop sat idle instead of starting a frame; the gap until the next
+    // frame start isn't a frame time.
+    void idled();
+
+    // time between consecutive frame starts
+    const LatencyStats& frameTimes() const { return intervals; }
+
+private:
+    const Clock& clock;
+    double period;
+    int maxFramesInFlight;
+    double deadline;
+    double frameStart;
+    double lastFrameStart;
+    // smoothed time from frame start to the swap
+    double buildEstimate;
+    std::deque<GLsync> fences;
+    LatencyStats intervals;
+};
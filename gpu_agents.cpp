@@ -0,0 +1,84 @@
+#include "gpu_agents.h"
+
+#include <GL/glew.h>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+const int stateTextureWidth = 1024;
+
+GpuAgents::GpuAgents(int agentCount, unsigned int updateShader)
+    : agentCount(agentCount), current(0), updateShader(updateShader) {
+    width = stateTextureWidth;
+    height = (agentCount + width - 1) / width;
+
+    // spread along the same stretch of yard the CPU dogs use, resting, with staggered timers
+    vector<float> initial(width * height * 4, 0.0f);
+    for (int i = 0; i < agentCount; ++i) {
+        float t = fmod(i * 0.618034f, 1.0f);
+        initial[i * 4 + 0] = -0.1f + 1.4f * t;
+        initial[i * 4 + 1] = (i & 1) ? -0.12f : 0.12f;
+        initial[i * 4 + 2] = 0.0f;
+        initial[i * 4 + 3] = 3.0f * t;
+    }
+
+    glGenTextures(2, stateTextures);
+    glGenFramebuffers(2, framebuffers);
+    for (int i = 0; i < 2; ++i) {
+        glBindTexture(GL_TEXTURE_2D, stateTextures[i]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, initial.data());
+
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, stateTextures[i], 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "GPU agent state framebuffer is incomplete" << std::endl;
+        }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // the update pass builds its full-screen triangle from gl_VertexID
+    glGenVertexArrays(1, &emptyVAO);
+
+    uStateLoc = glGetUniformLocation(updateShader, "uState");
+    uDtLoc = glGetUniformLocation(updateShader, "uDt");
+    uTimeLoc = glGetUniformLocation(updateShader, "uTime");
+}
+
+GpuAgents::~GpuAgents() {
+    glDeleteFramebuffers(2, framebuffers);
+    glDeleteTextures(2, stateTextures);
+    glDeleteVertexArrays(1, &emptyVAO);
+}
+
+void GpuAgents::step(float dt, float time) {
+    int next = 1 - current;
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[next]);
+    glViewport(0, 0, width, height);
+    glDisable(GL_BLEND);
+
+    glUseProgram(updateShader);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, stateTextures[current]);
+    glUniform1i(uStateLoc, 0);
+    glUniform1f(uDtLoc, dt);
+    glUniform1f(uTimeLoc, time);
+
+    glBindVertexArray(emptyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    current = next;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+// Optional GPU-resident dog simulation for agent counts the CPU path can't
+// reach. Each agent is one RGBA32F texel (x, velocity x, state, timer) in a
+// pair of state textures; a fragment-shader pass reads one and renders the next
+// step into the other through an FBO, then the two swap. Nothing is read back:
+// dog.vert fetches both textures by gl_InstanceID and interpolates between
+// them, so the previous step comes for free.
+class GpuAgents {
+public:
+    // updateShader is the agent_update program; needs a current GL context
+    GpuAgents(int agentCount, unsigned int updateShader);
+    ~GpuAgents();
+
+    void step(float dt, float time);
+
+    int count() const { return agentCount; }
+    unsigned int previousStateTexture() const { return stateTextures[1 - current]; }
+    unsigned int currentStateTexture() const { return stateTextures[current]; }
+
+private:
+    int agentCount;
+    int width;
+    int height;
+    int current;
+    unsigned int updateShader;
+    unsigned int stateTextures[2];
+    unsigned int framebuffers[2];
+    unsigned int emptyVAO;
+    int uStateLoc;
+    int uDtLoc;
+    int uTimeLoc;
+};
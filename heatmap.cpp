@@ -0,0 +1,69 @@
+#include "heatmap.h"
+
+#include <GL/glew.h>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+// counts past this all get the hottest colour
+const int heatLevels = 8;
+
+OverdrawHeatmap::OverdrawHeatmap(unsigned int shader) : shader(shader) {
+    // the fullscreen triangle comes from gl_VertexID
+    glGenVertexArrays(1, &emptyVAO);
+    uHeatLoc = glGetUniformLocation(shader, "uHeat");
+}
+
+OverdrawHeatmap::~OverdrawHeatmap() {
+    glDeleteVertexArrays(1, &emptyVAO);
+}
+
+void OverdrawHeatmap::begin() {
+    glClearStencil(0);
+    glClear(GL_STENCIL_BUFFER_BIT);
+    glEnable(GL_STENCIL_TEST);
+    glStencilFunc(GL_ALWAYS, 0, 0xFF);
+    // counted once the fragment passes the depth test, i.e. when it's actually drawn
+    glStencilOp(GL_KEEP, GL_KEEP, GL_INCR);
+}
+
+void OverdrawHeatmap::end() {
+    glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    glUseProgram(shader);
+    glBindVertexArray(emptyVAO);
+    // untouched pixels (count 0) go black
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    for (int level = 1; level <= heatLevels; ++level) {
+        // the last level takes everything at or above it
+        glStencilFunc(level < heatLevels ? GL_EQUAL : GL_LEQUAL, level, 0xFF);
+        glUniform1f(uHeatLoc, (float)(level - 1) / (heatLevels - 1));
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glEnable(GL_BLEND);
+    glDisable(GL_STENCIL_TEST);
+}
+
+bool saveFramebufferImage(const string& path, int width, int height) {
+    vector<unsigned char> pixels((size_t)width * height * 3);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+
+    ofstream file(path.c_str(), ios::binary);
+    file << "P6\n" << width << " " << height << "\n255\n";
+    // GL rows go bottom up, PPM rows top down
+    for (int y = height - 1; y >= 0; --y) {
+        file.write((const char*)&pixels[(size_t)y * width * 3], (streamsize)width * 3);
+    }
+    if (!file) {
+        cerr << "Failed to write image: " << path << endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,15 @@
+#version 330 core
+
+out vec4 FragColor;
+
+// 0 = drawn once .. 1 = drawn the most
+uniform float uHeat;
+
+void main() {
+    // blue, cyan, green, yellow, red, white
+    const vec3 ramp[6] = vec3[](vec3(0.0, 0.0, 0.6), vec3(0.0, 0.7, 1.0), vec3(0.0, 0.8, 0.0),
+                                vec3(1.0, 1.0, 0.0), vec3(1.0, 0.0, 0.0), vec3(1.0, 1.0, 1.0));
+    float position = uHeat * 5.0;
+    int index = min(int(position), 4);
+    FragColor = vec4(mix(ramp[index], ramp[index + 1], position - float(index)), 1.0);
+}
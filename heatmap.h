@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+
+// Debug view of where fill rate goes. While it's on, every fragment that
+// reaches the frame bumps its pixel's stencil value (saturating at 255), so
+// after the frame's passes the stencil holds how many times each pixel was
+// written. end() then paints the frame over with one colour per count: blue
+// for pixels drawn once through to red and white for the worst overdraw.
+// Needs the bound framebuffer to have a stencil buffer nobody else is using
+// for the frame (the retained frame with full damage).
+class OverdrawHeatmap {
+public:
+    // shader is the heatmap program; needs a current GL context
+    explicit OverdrawHeatmap(unsigned int shader);
+    ~OverdrawHeatmap();
+    OverdrawHeatmap(const OverdrawHeatmap&) = delete;
+    OverdrawHeatmap& operator=(const OverdrawHeatmap&) = delete;
+
+    // Before the frame's first draw: clears the counts and starts counting.
+    void begin();
+    // After its last: replaces the frame with the heatmap.
+    void end();
+
+private:
+    unsigned int shader;
+    int uHeatLoc;
+    unsigned int emptyVAO;
+};
+
+// Writes the bound read framebuffer's colour as a binary PPM.
+bool saveFramebufferImage(const std::string& path, int width, int height);
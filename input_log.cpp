@@ -0,0 +1,178 @@
+#include "input_log.h"
+#include "world.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+static const char logMagic[4] = { 'L', 'G', 'I', 'N' };
+static const unsigned char logVersion = 1;
+
+static void writeU32(vector<unsigned char>& out, unsigned int v) {
+    for (int i = 0; i < 4; ++i) {
+        out.push_back((unsigned char)(v >> (8 * i)));
+    }
+}
+
+static void writeVarint(vector<unsigned char>& out, unsigned int v) {
+    while (v >= 0x80) {
+        out.push_back((unsigned char)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((unsigned char)v);
+}
+
+static void writeFloat(vector<unsigned char>& out, float f) {
+    unsigned int bits;
+    memcpy(&bits, &f, sizeof(bits));
+    writeU32(out, bits);
+}
+
+// Reads from a byte buffer; any read past the end flags the whole read as failed.
+struct LogReader {
+    const vector<unsigned char>& data;
+    size_t pos;
+    bool failed;
+
+    explicit LogReader(const vector<unsigned char>& data) : data(data), pos(0), failed(false) {}
+
+    unsigned char byte() {
+        if (pos >= data.size()) {
+            failed = true;
+            return 0;
+        }
+        return data[pos++];
+    }
+
+    unsigned int u32() {
+        unsigned int v = 0;
+        for (int i = 0; i < 4; ++i) {
+            v |= (unsigned int)byte() << (8 * i);
+        }
+        return v;
+    }
+
+    unsigned int varint() {
+        unsigned int v = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            unsigned char b = byte();
+            v |= (unsigned int)(b & 0x7F) << shift;
+            if (!(b & 0x80)) {
+                return v;
+            }
+        }
+        failed = true;
+        return v;
+    }
+
+    float f32() {
+        unsigned int bits = u32();
+        float f;
+        memcpy(&f, &bits, sizeof(f));
+        return f;
+    }
+};
+
+bool saveInputLog(const InputLog& log, const string& path) {
+    vector<unsigned char> out(logMagic, logMagic + 4);
+    out.push_back(logVersion);
+    writeU32(out, log.seed);
+    writeU32(out, (unsigned int)log.dogCount);
+    writeU32(out, (unsigned int)log.birdCount);
+    writeU32(out, log.tickCount);
+    writeU32(out, (unsigned int)log.events.size());
+
+    unsigned int lastTick = 0;
+    for (size_t i = 0; i < log.events.size(); ++i) {
+        const InputEvent& event = log.events[i];
+        out.push_back(event.type);
+        writeVarint(out, event.tick - lastTick);
+        lastTick = event.tick;
+        if (event.type == INPUT_EVENT_KEYS) {
+            writeVarint(out, event.keys);
+        }
+        else {
+            writeFloat(out, event.x);
+            writeFloat(out, event.y);
+        }
+    }
+
+    ofstream file(path.c_str(), ios::binary);
+    file.write((const char*)out.data(), out.size());
+    if (!file) {
+        cerr << "Failed to write input log: " << path << endl;
+        return false;
+    }
+    return true;
+}
+
+bool loadInputLog(InputLog& log, const string& path) {
+    ifstream file(path.c_str(), ios::binary);
+    if (!file) {
+        cerr << "Failed to open input log: " << path << endl;
+        return false;
+    }
+    vector<unsigned char> data((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+
+    LogReader in(data);
+    bool magicOk = data.size() >= 4 && memcmp(data.data(), logMagic, 4) == 0;
+    in.pos = 4;
+    if (!magicOk || in.byte() != logVersion) {
+        cerr << "Not an input log (or an unsupported version): " << path << endl;
+        return false;
+    }
+
+    log.seed = in.u32();
+    log.dogCount = (int)in.u32();
+    log.birdCount = (int)in.u32();
+    log.tickCount = in.u32();
+    unsigned int eventCount = in.u32();
+
+    log.events.clear();
+    unsigned int tick = 0;
+    for (unsigned int i = 0; i < eventCount && !in.failed; ++i) {
+        InputEvent event = {};
+        event.type = in.byte();
+        tick += in.varint();
+        event.tick = tick;
+        if (event.type > INPUT_EVENT_FOOD) {
+            in.failed = true;
+        }
+        else if (event.type == INPUT_EVENT_KEYS) {
+            event.keys = in.varint();
+        }
+        else {
+            event.x = in.f32();
+            event.y = in.f32();
+        }
+        log.events.push_back(event);
+    }
+
+    if (in.failed) {
+        cerr << "Input log is truncated or corrupt: " << path << endl;
+        return false;
+    }
+    return true;
+}
+
+InputPlayer::InputPlayer(const InputLog& log) : log(log), next(0), keys(0) {
+}
+
+unsigned int InputPlayer::apply(World& world, unsigned int tick) {
+    while (next < log.events.size() && log.events[next].tick <= tick) {
+        const InputEvent& event = log.events[next++];
+        if (event.type == INPUT_EVENT_KEYS) {
+            keys = event.keys;
+        }
+        else {
+            world.spawnFood(event.x, event.y);
+        }
+    }
+    return keys;
+}
+
+bool InputPlayer::finished(unsigned int tick) const {
+    return next >= log.events.size() && tick >= log.tickCount;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class World;
+
+enum InputEventType {
+    // the held keys (InputKey bits) changed to keys
+    INPUT_EVENT_KEYS,
+    // a click dropped food at (x, y)
+    INPUT_EVENT_FOOD
+};
+
+// One input as the simulation consumed it, at the start of step tick.
+struct InputEvent {
+    unsigned int tick;
+    unsigned char type;
+    unsigned int keys;
+    float x;
+    float y;
+};
+
+// Everything needed to play a run back exactly: how its world was created and
+// every input it got, stamped with the step it was applied on. Events are in
+// tick order.
+struct InputLog {
+    unsigned int seed;
+    int dogCount;
+    int birdCount;
+    // steps the recorded run lasted
+    unsigned int tickCount;
+    std::vector<InputEvent> events;
+};
+
+// Binary format: a fixed header, then per event a type byte, the tick delta
+// from the previous event as a varint and the payload (keys as a varint,
+// food as two little-endian floats). A few bytes per event.
+bool saveInputLog(const InputLog& log, const std::string& path);
+bool loadInputLog(InputLog& log, const std::string& path);
+
+// Feeds a log back into a world in step with the simulation.
+class InputPlayer {
+public:
+    explicit InputPlayer(const InputLog& log);
+
+    // Drops the food logged for this tick into world and returns the keys held during it.
+    unsigned int apply(World& world, unsigned int tick);
+    bool finished(unsigned int tick) const;
+
+private:
+    const InputLog& log;
+    size_t next;
+    unsigned int keys;
+};
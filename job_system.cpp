@@ -0,0 +1,226 @@
+#include "job_system.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+using namespace std;
+
+// which system and queue the current thread belongs to, if it is a worker
+static thread_local const JobSystem* workerSystem = nullptr;
+static thread_local size_t workerQueue = 0;
+
+JobSystem::JobSystem(unsigned int threadCount)
+    : queuedJobs(0), running(true) {
+    if (threadCount == 0) {
+        threadCount = max(1u, thread::hardware_concurrency());
+    }
+    for (unsigned int i = 0; i <= threadCount; ++i) {
+        queues.push_back(unique_ptr<Queue>(new Queue()));
+    }
+    for (unsigned int i = 0; i < threadCount; ++i) {
+        workers.push_back(thread(&JobSystem::workerMain, this, i));
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        lock_guard<mutex> lock(sleepMutex);
+        running = false;
+    }
+    wake.notify_all();
+    for (size_t i = 0; i < workers.size(); ++i) {
+        workers[i].join();
+    }
+}
+
+size_t JobSystem::currentQueue() const {
+    return workerSystem == this ? workerQueue : queues.size() - 1;
+}
+
+void JobSystem::run(const char* name, function<void()> fn, JobCounter* counter) {
+    if (counter) {
+        counter->pending.fetch_add(1, memory_order_relaxed);
+    }
+    Job job = { std::move(fn), name, counter };
+    push(std::move(job));
+}
+
+void JobSystem::runAfter(JobCounter& dependency, const char* name, function<void()> fn, JobCounter* counter) {
+    if (counter) {
+        counter->pending.fetch_add(1, memory_order_relaxed);
+    }
+    Job job = { std::move(fn), name, counter };
+
+    unique_lock<mutex> lock(dependency.mutex);
+    if (!dependency.done()) {
+        dependency.continuations.push_back(std::move(job));
+        return;
+    }
+    lock.unlock();
+    push(std::move(job));
+}
+
+void JobSystem::push(Job job) {
+    Queue& queue = *queues[currentQueue()];
+    {
+        lock_guard<mutex> lock(queue.mutex);
+        queue.jobs.push_back(std::move(job));
+    }
+    queuedJobs.fetch_add(1);
+    // taking the lock orders this against a worker that is about to sleep
+    lock_guard<mutex> lock(sleepMutex);
+    wake.notify_one();
+}
+
+bool JobSystem::tryRunOne() {
+    size_t self = currentQueue();
+    Job job;
+    bool found = false;
+
+    {
+        Queue& own = *queues[self];
+        lock_guard<mutex> lock(own.mutex);
+        if (!own.jobs.empty()) {
+            job = std::move(own.jobs.back());
+            own.jobs.pop_back();
+            found = true;
+        }
+    }
+    for (size_t i = 1; !found && i < queues.size(); ++i) {
+        Queue& victim = *queues[(self + i) % queues.size()];
+        lock_guard<mutex> lock(victim.mutex);
+        if (!victim.jobs.empty()) {
+            job = std::move(victim.jobs.front());
+            victim.jobs.pop_front();
+            found = true;
+        }
+    }
+
+    if (!found) {
+        return false;
+    }
+    queuedJobs.fetch_sub(1);
+    execute(job, *queues[self]);
+    return true;
+}
+
+void JobSystem::execute(const Job& job, Queue& queue) {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    job.fn();
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    {
+        lock_guard<mutex> lock(queue.timingMutex);
+        JobTiming& timing = queue.timings[job.name];
+        if (timing.count == 0) {
+            timing.name = job.name;
+            timing.maxMs = 0.0;
+            timing.totalMs = 0.0;
+        }
+        ++timing.count;
+        timing.totalMs += ms;
+        timing.maxMs = max(timing.maxMs, ms);
+    }
+
+    finish(job.counter);
+}
+
+void JobSystem::finish(JobCounter* counter) {
+    if (!counter) {
+        return;
+    }
+
+    // The drop to zero and the swap happen under the counter's lock: a waiter
+    // that sees done() takes the lock before returning, so the counter (often
+    // on its stack) outlives this.
+    vector<Job> ready;
+    {
+        lock_guard<mutex> lock(counter->mutex);
+        if (counter->pending.fetch_sub(1, memory_order_acq_rel) != 1) {
+            return;
+        }
+        ready.swap(counter->continuations);
+    }
+    for (size_t i = 0; i < ready.size(); ++i) {
+        push(std::move(ready[i]));
+    }
+}
+
+void JobSystem::wait(JobCounter& counter) {
+    while (!counter.done()) {
+        if (!tryRunOne()) {
+            this_thread::yield();
+        }
+    }
+    // wait out the finish() that dropped it to zero
+    lock_guard<mutex> lock(counter.mutex);
+}
+
+void JobSystem::parallelFor(const char* name, size_t count, size_t grain, const function<void(size_t, size_t)>& fn) {
+    grain = max<size_t>(grain, 1);
+    JobCounter counter;
+    for (size_t begin = 0; begin < count; begin += grain) {
+        size_t end = min(begin + grain, count);
+        run(name, [&fn, begin, end] { fn(begin, end); }, &counter);
+    }
+    wait(counter);
+}
+
+void JobSystem::workerMain(size_t index) {
+    workerSystem = this;
+    workerQueue = index;
+
+    while (running.load()) {
+        if (tryRunOne()) {
+            continue;
+        }
+        unique_lock<mutex> lock(sleepMutex);
+        wake.wait(lock, [this] { return queuedJobs.load() > 0 || !running.load(); });
+    }
+}
+
+vector<JobTiming> JobSystem::timings() const {
+    map<string, JobTiming> merged;
+    for (size_t i = 0; i < queues.size(); ++i) {
+        lock_guard<mutex> lock(queues[i]->timingMutex);
+        for (map<string, JobTiming>::const_iterator it = queues[i]->timings.begin(); it != queues[i]->timings.end(); ++it) {
+            JobTiming& total = merged[it->first];
+            if (total.count == 0) {
+                total = it->second;
+                continue;
+            }
+            total.count += it->second.count;
+            total.totalMs += it->second.totalMs;
+            total.maxMs = max(total.maxMs, it->second.maxMs);
+        }
+    }
+
+    vector<JobTiming> result;
+    for (map<string, JobTiming>::iterator it = merged.begin(); it != merged.end(); ++it) {
+        result.push_back(it->second);
+    }
+    sort(result.begin(), result.end(), [](const JobTiming& a, const JobTiming& b) { return a.totalMs > b.totalMs; });
+    return result;
+}
+
+void JobSystem::resetTimings() {
+    for (size_t i = 0; i < queues.size(); ++i) {
+        lock_guard<mutex> lock(queues[i]->timingMutex);
+        queues[i]->timings.clear();
+    }
+}
+
+void printJobTimings(const JobSystem& jobs) {
+    vector<JobTiming> timings = jobs.timings();
+    if (timings.empty()) {
+        return;
+    }
+    cout << "Jobs (" << jobs.size() << " workers):" << endl;
+    for (size_t i = 0; i < timings.size(); ++i) {
+        cout << "  " << left << setw(16) << timings[i].name << right
+            << " " << timings[i].count << " runs, " << timings[i].totalMs << " ms total, "
+            << timings[i].totalMs / timings[i].count << " ms avg, " << timings[i].maxMs << " ms max" << endl;
+    }
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class JobCounter;
+
+struct Job {
+    std::function<void()> fn;
+    const char* name;
+    // decremented when fn returns
+    JobCounter* counter;
+};
+
+// Number of unfinished jobs tied to it. Jobs queued with runAfter() on a
+// counter start only once it reaches zero.
+class JobCounter {
+public:
+    JobCounter() : pending(0) {}
+
+    bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class JobSystem;
+
+    std::atomic<int> pending;
+    std::mutex mutex;
+    std::vector<Job> continuations;
+};
+
+// Accumulated run time of all jobs with one name.
+struct JobTiming {
+    std::string name;
+    size_t count;
+    double totalMs;
+    double maxMs;
+};
+
+// Work-stealing job system. Every worker owns a deque: it pushes and pops its
+// own jobs at the back (newest first, still warm in cache) and, when that runs
+// dry, steals the oldest job from the front of someone else's. Threads outside
+// the system share one more deque. A thread that waits on a counter runs jobs
+// in the meantime, so jobs may wait on jobs they spawned.
+class JobSystem {
+public:
+    // 0 = one worker per core
+    explicit JobSystem(unsigned int threadCount = 0);
+    ~JobSystem();
+
+    unsigned int size() const { return (unsigned int)workers.size(); }
+
+    // Queues fn; counter, if given, is bumped now and dropped when fn finishes.
+    void run(const char* name, std::function<void()> fn, JobCounter* counter = nullptr);
+    // Queues fn once dependency reaches zero.
+    void runAfter(JobCounter& dependency, const char* name, std::function<void()> fn, JobCounter* counter = nullptr);
+    // Runs queued jobs on the calling thread until counter reaches zero.
+    void wait(JobCounter& counter);
+
+    // Calls fn(begin, end) over [0, count) in ranges of at most grain items and waits for all of them.
+    void parallelFor(const char* name, size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn);
+
+    // Per-name totals since the last reset, slowest first.
+    std::vector<JobTiming> timings() const;
+    void resetTimings();
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+        // timings of the jobs this queue's thread ran
+        std::map<std::string, JobTiming> timings;
+        mutable std::mutex timingMutex;
+    };
+
+    void workerMain(size_t index);
+    size_t currentQueue() const;
+    void push(Job job);
+    bool tryRunOne();
+    void execute(const Job& job, Queue& queue);
+    void finish(JobCounter* counter);
+
+    std::vector<std::thread> workers;
+    // one per worker, plus a shared one at the end for outside threads
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::atomic<int> queuedJobs;
+    std::atomic<bool> running;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+};
+
+void printJobTimings(const JobSystem& jobs);
@@ -0,0 +1,26 @@
+#include "latency_stats.h"
+
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+void LatencyStats::print(const char* label) const {
+    if (samples.empty()) {
+        cout << label << ": no samples" << endl;
+        return;
+    }
+
+    vector<double> sorted(samples);
+    sort(sorted.begin(), sorted.end());
+    double sum = 0.0;
+    for (size_t i = 0; i < sorted.size(); ++i) {
+        sum += sorted[i];
+    }
+    size_t last = sorted.size() - 1;
+
+    cout << label << ": " << sorted.size() << " samples, mean " << sum / sorted.size() * 1000.0
+        << " ms, p50 " << sorted[last / 2] * 1000.0
+        << " ms, p95 " << sorted[last * 95 / 100] * 1000.0
+        << " ms, max " << sorted[last] * 1000.0 << " ms" << endl;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Collects latency samples (seconds) and prints their distribution.
+class LatencyStats {
+public:
+    void add(double seconds) { samples.push_back(seconds); }
+    size_t count() const { return samples.size(); }
+    // e.g. "Input to present: 42 samples, mean 21.3 ms, p50 ..., p95 ..., max ..."
+    void print(const char* label) const;
+
+private:
+    std::vector<double> samples;
+};
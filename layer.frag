@@ -0,0 +1,10 @@
+#version 330 core
+
+in vec2 TexCoord;
+out vec4 FragColor;
+
+uniform sampler2D uLayer; // premultiplied alpha
+
+void main() {
+    FragColor = texture(uLayer, TexCoord);
+}
@@ -0,0 +1,12 @@
+#version 330 core
+
+// One triangle that covers the whole window; the layer is window-sized.
+out vec2 TexCoord;
+
+uniform float uDepth;
+
+void main() {
+    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    TexCoord = position;
+    gl_Position = vec4(position * 2.0 - 1.0, uDepth, 1.0);
+}
@@ -0,0 +1,209 @@
+#include "layer_cache.h"
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+using namespace std;
+
+LayerCache::LayerCache(int layerCount, unsigned int compositeShader)
+    : layers(layerCount), compositeTexture(0), compositeFramebuffer(0), depthBuffer(0), compositeShader(compositeShader),
+      width(0), height(0), current(-1) {
+    for (size_t i = 0; i < layers.size(); ++i) {
+        Layer& layer = layers[i];
+        layer.texture = 0;
+        layer.framebuffer = 0;
+        layer.valid = false;
+        layer.bounds[0] = -1.0f;
+        layer.bounds[1] = -1.0f;
+        layer.bounds[2] = 1.0f;
+        layer.bounds[3] = 1.0f;
+    }
+    damage.x0 = damage.y0 = damage.x1 = damage.y1 = 0;
+
+    // the composite passes build their fullscreen triangle from gl_VertexID
+    glGenVertexArrays(1, &emptyVAO);
+    uLayerLoc = glGetUniformLocation(compositeShader, "uLayer");
+}
+
+LayerCache::~LayerCache() {
+    for (size_t i = 0; i < layers.size(); ++i) {
+        glDeleteFramebuffers(1, &layers[i].framebuffer);
+        glDeleteTextures(1, &layers[i].texture);
+    }
+    glDeleteFramebuffers(1, &compositeFramebuffer);
+    glDeleteTextures(1, &compositeTexture);
+    glDeleteRenderbuffers(1, &depthBuffer);
+    glDeleteVertexArrays(1, &emptyVAO);
+}
+
+void LayerCache::createTarget(unsigned int& texture, unsigned int& framebuffer, bool withDepth) {
+    if (!texture) {
+        glGenTextures(1, &texture);
+        glGenFramebuffers(1, &framebuffer);
+    }
+    glBindTexture(GL_TEXTURE_2D, texture);
+    // one texel per pixel, sampled at texel centres
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+    if (withDepth) {
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    }
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        cerr << "Layer framebuffer is incomplete" << endl;
+    }
+}
+
+void LayerCache::resize(int width, int height) {
+    if (width == this->width && height == this->height) {
+        return;
+    }
+    this->width = width;
+    this->height = height;
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+
+    // layers are drawn one at a time, so they can all share one depth buffer
+    if (!depthBuffer) {
+        glGenRenderbuffers(1, &depthBuffer);
+    }
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    for (size_t i = 0; i < layers.size(); ++i) {
+        createTarget(layers[i].texture, layers[i].framebuffer, true);
+        layers[i].valid = false;
+    }
+    createTarget(compositeTexture, compositeFramebuffer, false);
+    damage.x0 = 0;
+    damage.y0 = 0;
+    damage.x1 = width;
+    damage.y1 = height;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void LayerCache::setBounds(int layer, float minX, float minY, float maxX, float maxY) {
+    Layer& l = layers[layer];
+    l.bounds[0] = minX;
+    l.bounds[1] = minY;
+    l.bounds[2] = maxX;
+    l.bounds[3] = maxY;
+    l.valid = false;
+}
+
+bool LayerCache::needsRedraw(int layer, const float* key, int keySize) {
+    Layer& l = layers[layer];
+    bool same = l.valid && (int)l.key.size() == keySize && equal(key, key + keySize, l.key.begin());
+    if (!same) {
+        l.key.assign(key, key + keySize);
+    }
+    return !same;
+}
+
+PixelRect LayerCache::pixelBounds(const Layer& layer) const {
+    // rounded outwards so edge pixels a primitive only partly covers are included
+    PixelRect rect;
+    rect.x0 = max(0, (int)floor((layer.bounds[0] + 1.0f) * 0.5f * width));
+    rect.y0 = max(0, (int)floor((layer.bounds[1] + 1.0f) * 0.5f * height));
+    rect.x1 = min(width, (int)ceil((layer.bounds[2] + 1.0f) * 0.5f * width));
+    rect.y1 = min(height, (int)ceil((layer.bounds[3] + 1.0f) * 0.5f * height));
+    return rect;
+}
+
+void LayerCache::addDamage(const PixelRect& rect) {
+    if (damage.x0 >= damage.x1) {
+        damage = rect;
+        return;
+    }
+    damage.x0 = min(damage.x0, rect.x0);
+    damage.y0 = min(damage.y0, rect.y0);
+    damage.x1 = max(damage.x1, rect.x1);
+    damage.y1 = max(damage.y1, rect.y1);
+}
+
+void LayerCache::beginLayer(int layer) {
+    current = layer;
+    PixelRect rect = pixelBounds(layers[layer]);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, layers[layer].framebuffer);
+    glViewport(0, 0, width, height);
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(rect.x0, rect.y0, rect.x1 - rect.x0, rect.y1 - rect.y0);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    // straight-alpha draws come out premultiplied, with coverage accumulated in alpha
+    glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void LayerCache::endLayer() {
+    glDisable(GL_SCISSOR_TEST);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    layers[current].valid = true;
+    addDamage(pixelBounds(layers[current]));
+    current = -1;
+}
+
+void LayerCache::composite(PixelRect& changed) {
+    changed = damage;
+    if (damage.x0 >= damage.x1 || damage.y0 >= damage.y1) {
+        return;
+    }
+
+    glUseProgram(compositeShader);
+    glUniform1i(uLayerLoc, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindVertexArray(emptyVAO);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, compositeFramebuffer);
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(damage.x0, damage.y0, damage.x1 - damage.x0, damage.y1 - damage.y0);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    for (size_t i = 0; i < layers.size(); ++i) {
+        if (layers[i].valid) {
+            glBindTexture(GL_TEXTURE_2D, layers[i].texture);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+    }
+    glDisable(GL_SCISSOR_TEST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    damage.x0 = damage.y0 = damage.x1 = damage.y1 = 0;
+
+    glBindVertexArray(0);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glUseProgram(0);
+}
+
+void LayerCache::draw() {
+    drawTexture(compositeTexture);
+}
+
+void LayerCache::drawLayer(int layer) {
+    drawTexture(layers[layer].texture);
+}
+
+void LayerCache::drawTexture(unsigned int texture) {
+    glUseProgram(compositeShader);
+    glUniform1i(uLayerLoc, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glBindVertexArray(emptyVAO);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glUseProgram(0);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "damage.h"
+
+#include <vector>
+
+// Parts of the scene that rarely change, drawn once into window-sized
+// offscreen layers and reused until something they depend on changes. Each
+// layer remembers the values it was drawn with (its key: the sky colour, the
+// paint progress, ...) and is redrawn only when they differ. The layers are
+// flattened into one composite texture, so an unchanged background costs a
+// single fullscreen quad per frame, and a changed layer only touches its own
+// bounds. Layers hold premultiplied alpha, so translucent things in them end
+// up looking the same as when drawn straight to the window.
+class LayerCache {
+public:
+    // compositeShader is the layer program; needs a current GL context
+    LayerCache(int layerCount, unsigned int compositeShader);
+    ~LayerCache();
+    LayerCache(const LayerCache&) = delete;
+    LayerCache& operator=(const LayerCache&) = delete;
+
+    // Reallocates the layers if the framebuffer size changed; they all get redrawn.
+    void resize(int width, int height);
+    // The part of the window (in NDC) a layer draws into; a redraw clears and
+    // recomposites only that. Layers cover the whole window by default.
+    void setBounds(int layer, float minX, float minY, float maxX, float maxY);
+    // True if layer has to be redrawn because key differs from the one it was
+    // last drawn with. The new key is kept, so redraw it when this says so.
+    bool needsRedraw(int layer, const float* key, int keySize);
+    // Draw calls in between go into layer, cleared to transparent within its
+    // bounds. Layers have a depth buffer (cleared too) for drawing front to back.
+    void beginLayer(int layer);
+    void endLayer();
+    // Brings the composite up to date; changed is the part of it that changed
+    // (empty if none did). Call outside any other framebuffer's setup.
+    void composite(PixelRect& changed);
+    // Draws the composite over whatever framebuffer is bound.
+    void draw();
+    // Draws just one layer, as it was last drawn.
+    void drawLayer(int layer);
+
+private:
+    struct Layer {
+        unsigned int texture;
+        unsigned int framebuffer;
+        std::vector<float> key;
+        bool valid;
+        float bounds[4];
+    };
+
+    void createTarget(unsigned int& texture, unsigned int& framebuffer, bool withDepth);
+    PixelRect pixelBounds(const Layer& layer) const;
+    void addDamage(const PixelRect& rect);
+    void drawTexture(unsigned int texture);
+
+    std::vector<Layer> layers;
+    unsigned int compositeTexture;
+    unsigned int compositeFramebuffer;
+    unsigned int depthBuffer;
+    // part of the composite that's out of date; empty when x0 >= x1
+    PixelRect damage;
+    unsigned int compositeShader;
+    int uLayerLoc;
+    unsigned int emptyVAO;
+    int width;
+    int height;
+    int current;
+};
@@ -0,0 +1,28 @@
+#version 330 core
+
+out vec4 FragColor;
+
+uniform samplerBuffer uLights;        // per light: (x, y, radius) in pixels, then colour
+uniform isamplerBuffer uTiles;        // per tile: first index into uLightIndices, count
+uniform isamplerBuffer uLightIndices;
+uniform int uTileSize;
+uniform int uTilesX;
+
+void main() {
+    ivec2 tile = ivec2(gl_FragCoord.xy) / uTileSize;
+    int range = (tile.y * uTilesX + tile.x) * 2;
+    int first = texelFetch(uTiles, range).r;
+    int count = texelFetch(uTiles, range + 1).r;
+    if (count == 0) {
+        discard;
+    }
+
+    vec3 light = vec3(0.0);
+    for (int i = 0; i < count; ++i) {
+        int index = texelFetch(uLightIndices, first + i).r;
+        vec4 circle = texelFetch(uLights, index * 2);
+        float falloff = max(0.0, 1.0 - distance(gl_FragCoord.xy, circle.xy) / circle.z);
+        light += texelFetch(uLights, index * 2 + 1).rgb * falloff * falloff;
+    }
+    FragColor = vec4(light, 1.0);
+}
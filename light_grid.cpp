@@ -0,0 +1,172 @@
+#include "light_grid.h"
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+LightGrid::LightGrid(unsigned int shader, int tileSize, int maxTileLights)
+    : shader(shader), tileSize(tileSize), maxTileLights(maxTileLights), width(0), height(0), tilesX(0), tilesY(0),
+      litTiles(0), evaluated(0), dropped(0) {
+    glGenVertexArrays(1, &emptyVAO);
+    glGenBuffers(3, buffers);
+    glGenTextures(3, textures);
+    const GLenum formats[3] = { GL_RGBA32F, GL_R32I, GL_R32I };
+    for (int i = 0; i < 3; ++i) {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+        // a buffer texture needs some storage behind it even while it's unused
+        glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+        glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+        glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+    }
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    uLightsLoc = glGetUniformLocation(shader, "uLights");
+    uTilesLoc = glGetUniformLocation(shader, "uTiles");
+    uIndicesLoc = glGetUniformLocation(shader, "uLightIndices");
+    uTileSizeLoc = glGetUniformLocation(shader, "uTileSize");
+    uTilesXLoc = glGetUniformLocation(shader, "uTilesX");
+}
+
+LightGrid::~LightGrid() {
+    glDeleteTextures(3, textures);
+    glDeleteBuffers(3, buffers);
+    glDeleteVertexArrays(1, &emptyVAO);
+}
+
+void LightGrid::resize(int width, int height) {
+    this->width = width;
+    this->height = height;
+    tilesX = (width + tileSize - 1) / tileSize;
+    tilesY = (height + tileSize - 1) / tileSize;
+}
+
+static void upload(unsigned int buffer, const void* data, size_t bytes) {
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    // orphaned every frame so the driver never waits on last frame's draw
+    glBufferData(GL_TEXTURE_BUFFER, max(bytes, (size_t)16), nullptr, GL_STREAM_DRAW);
+    if (bytes > 0) {
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, data);
+    }
+}
+
+void LightGrid::update(const vector<PointLight>& lights) {
+    lightData.clear();
+    lightTiles.clear();
+    tileRanges.assign((size_t)tilesX * tilesY * 2, 0);
+    float pixelsPerUnit = height * 0.5f;
+
+    // first pass: pixel circles, their tile rectangles and how many lights each tile gets
+    for (size_t i = 0; i < lights.size(); ++i) {
+        const PointLight& light = lights[i];
+        float x = (light.x + 1.0f) * 0.5f * width;
+        float y = (light.y + 1.0f) * 0.5f * height;
+        float r = light.radius * pixelsPerUnit;
+        int tx0 = max(0, (int)floor((x - r) / tileSize));
+        int ty0 = max(0, (int)floor((y - r) / tileSize));
+        int tx1 = min(tilesX - 1, (int)floor((x + r) / tileSize));
+        int ty1 = min(tilesY - 1, (int)floor((y + r) / tileSize));
+        if (r <= 0.0f || tx0 > tx1 || ty0 > ty1) {
+            continue;
+        }
+        int index = (int)(lightData.size() / 8);
+        float data[8] = { x, y, r, 0.0f, light.color[0], light.color[1], light.color[2], 0.0f };
+        lightData.insert(lightData.end(), data, data + 8);
+        int rect[5] = { index, tx0, ty0, tx1, ty1 };
+        lightTiles.insert(lightTiles.end(), rect, rect + 5);
+    }
+
+    // The bounding rectangle overcounts the corners; a tile only gets the light
+    // if its nearest point to the centre is inside the circle.
+    for (int pass = 0; pass < 2; ++pass) {
+        if (pass == 1) {
+            int offset = 0;
+            litTiles = 0;
+            evaluated = 0;
+            dropped = 0;
+            for (int t = 0; t < tilesX * tilesY; ++t) {
+                int count = tileRanges[t * 2 + 1];
+                tileRanges[t * 2] = offset;
+                tileRanges[t * 2 + 1] = 0;
+                offset += count;
+                litTiles += count > 0;
+            }
+            indices.resize(offset);
+        }
+        for (size_t i = 0; i < lightTiles.size(); i += 5) {
+            const float* light = &lightData[lightTiles[i] * 8];
+            for (int ty = lightTiles[i + 2]; ty <= lightTiles[i + 4]; ++ty) {
+                float dy = max(0.0f, max(ty * (float)tileSize - light[1], light[1] - (ty + 1) * (float)tileSize));
+                for (int tx = lightTiles[i + 1]; tx <= lightTiles[i + 3]; ++tx) {
+                    float dx = max(0.0f, max(tx * (float)tileSize - light[0], light[0] - (tx + 1) * (float)tileSize));
+                    if (dx * dx + dy * dy >= light[2] * light[2]) {
+                        continue;
+                    }
+                    int* range = &tileRanges[(ty * tilesX + tx) * 2];
+                    if (pass == 1) {
+                        indices[range[0] + range[1]] = lightTiles[i];
+                    }
+                    ++range[1];
+                }
+            }
+        }
+    }
+
+    // Over the cap, a tile keeps the lights that are brightest at its nearest
+    // point to them; the rest of its slice of indices just goes unread.
+    for (int t = 0; t < tilesX * tilesY; ++t) {
+        int* range = &tileRanges[t * 2];
+        if (range[1] > maxTileLights) {
+            float left = (t % tilesX) * (float)tileSize;
+            float bottom = (t / tilesX) * (float)tileSize;
+            scores.resize(lightData.size() / 8);
+            for (int i = 0; i < range[1]; ++i) {
+                int index = indices[range[0] + i];
+                const float* light = &lightData[index * 8];
+                float dx = max(0.0f, max(left - light[0], light[0] - (left + tileSize)));
+                float dy = max(0.0f, max(bottom - light[1], light[1] - (bottom + tileSize)));
+                float falloff = 1.0f - sqrt(dx * dx + dy * dy) / light[2];
+                scores[index] = (light[4] + light[5] + light[6]) * falloff * falloff;
+            }
+            int* first = &indices[range[0]];
+            nth_element(first, first + maxTileLights - 1, first + range[1],
+                        [this](int a, int b) { return scores[a] > scores[b]; });
+            dropped += range[1] - maxTileLights;
+            range[1] = maxTileLights;
+        }
+        evaluated += range[1];
+    }
+
+    upload(buffers[0], lightData.data(), lightData.size() * sizeof(float));
+    upload(buffers[1], tileRanges.data(), tileRanges.size() * sizeof(int));
+    upload(buffers[2], indices.data(), indices.size() * sizeof(int));
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightGrid::draw() {
+    glUseProgram(shader);
+    const int locations[3] = { uLightsLoc, uTilesLoc, uIndicesLoc };
+    for (int i = 0; i < 3; ++i) {
+        glActiveTexture(GL_TEXTURE0 + i);
+        glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+        glUniform1i(locations[i], i);
+    }
+    glUniform1i(uTileSizeLoc, tileSize);
+    glUniform1i(uTilesXLoc, tilesX);
+    glBlendFunc(GL_ONE, GL_ONE);
+    glBindVertexArray(emptyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    for (int i = 2; i >= 0; --i) {
+        glActiveTexture(GL_TEXTURE0 + i);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+    glUseProgram(0);
+}
+
+double LightGrid::averageTileLights() const {
+    return litTiles > 0 ? (double)evaluated / litTiles : 0.0;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+
+// A 2D point light: position in NDC, radius in NDC heights (so it's round on
+// screen), additive colour at its centre, falling off to nothing at the radius.
+struct PointLight {
+    float x;
+    float y;
+    float radius;
+    float color[3];
+};
+
+// Tiled light culling for the lit pass. The window is cut into square tiles
+// and every frame each light is binned on the CPU into the tiles its circle
+// touches; the lights, each tile's slice of a flat index list and the list go
+// up in three buffer textures. The lit pass is one fullscreen triangle that
+// looks up its pixel's tile and only evaluates that tile's lights, so the cost
+// is pixels times nearby lights rather than pixels times all lights, and
+// tiles no light reaches are discarded straight away. A tile keeps at most
+// maxTileLights lights, the ones that can light it the most, so a swarm
+// bunched into a few tiles can't make those tiles arbitrarily slow.
+class LightGrid {
+public:
+    // shader is the light program; needs a current GL context
+    explicit LightGrid(unsigned int shader, int tileSize = 32, int maxTileLights = 16);
+    ~LightGrid();
+    LightGrid(const LightGrid&) = delete;
+    LightGrid& operator=(const LightGrid&) = delete;
+
+    void resize(int width, int height);
+    // Bins lights into tiles and uploads everything for draw().
+    void update(const std::vector<PointLight>& lights);
+    // Adds the light over the bound framebuffer.
+    void draw();
+
+    bool empty() const { return lightData.empty(); }
+    // light evaluations per lit tile in the last update
+    double averageTileLights() const;
+    // tile lights left out over maxTileLights in the last update
+    int droppedTileLights() const { return dropped; }
+
+private:
+    unsigned int shader;
+    int uLightsLoc;
+    int uTilesLoc;
+    int uIndicesLoc;
+    int uTileSizeLoc;
+    int uTilesXLoc;
+    unsigned int emptyVAO;
+    // buffer + texture each: lights (2 RGBA32F texels per light), tiles
+    // (first index and count per tile, R32I) and light indices (R32I)
+    unsigned int buffers[3];
+    unsigned int textures[3];
+
+    int tileSize;
+    int maxTileLights;
+    int width;
+    int height;
+    int tilesX;
+    int tilesY;
+    // pixel circle and colour per light, as uploaded
+    std::vector<float> lightData;
+    std::vector<int> tileRanges;
+    std::vector<int> indices;
+    // per light: tile rectangle it touches, kept between the two binning passes
+    std::vector<int> lightTiles;
+    int litTiles;
+    int evaluated;
+    int dropped;
+    std::vector<float> scores;
+};
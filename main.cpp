@@ -17,6 +17,23 @@
 #include <vector>
 #include <cmath>
 #include "stb_image.h"
+#include "simulation.h"
+#include "batch.h"
+#include "clock.h"
+#include "curves.h"
+#include "gpu_agents.h"
+#include "job_system.h"
+#include "input_log.h"
+#include "latency_stats.h"
+#include "frame_pacer.h"
+#include "layer_cache.h"
+#include "damage.h"
+#include "fragment_counter.h"
+#include "heatmap.h"
+#include "oit.h"
+#include "light_grid.h"
+#include "shadow_map.h"
+#include "pcg.h"
 #include <cstring>
 #include FT_FREETYPE_H
 
@@ -27,60 +44,136 @@ const unsigned int SCR_HEIGHT = 720;
 const char* WINDOW_TITLE = "LumberGL";
 const char* infoText = "Dusan Lecic SV80/2021";
 
-const float transitionDuration = 5.0f;
-bool isDay = true;
-bool keyPressed = false;
-bool transitionInProgress = false;
-bool dogGoingLeft = false;
-bool transparencyEnabled = false;
-bool lightEnabled = false;
 bool lightAlpha = 0.5;
 float windowAlpha = 0.25;
-float paintProgress = 0.0f;
 float timeOfDay = 0.3f;
-float dimFactor = 1.0f;
-float transitionStartTime = 0.0f;
-float sunMoonProgress = 0.0f;
-float skyColor[3] = { 0.412f, 0.737f, 0.851f };
-float daySkyColor[3] = { 0.412f, 0.737f, 0.851f };
-float nightSkyColor[3] = { 0.0f, 0.0f, 0.1f };
 float objectDimFactor = 1.0f;
-float dogSpeed = 0.003f;
-float dogX = 0.0f;
-float dogY = 0.0f;
-float dogMinX = -0.1f;
-float dogMaxX = 1.3f;
-float dogTopY = dogY + (-0.55f);
-float dogCenterX = -0.65f;
-float zInitialY = dogTopY + 0.05f;
 float chimneyX = 0.125f;
 float chimneyY = 0.33f;
-float dogPreviousX = dogX;
-float dogPreviousY = dogY;
-float dogStartingX;
-float eatingStartTime = 0.0f;
-float eatingDuration = 0.0f;
-int selectedRoom = -1;
+// vblanks per swap: 1 = vsync, 0 = uncapped, 2 = half the refresh rate
+int swapInterval = 1;
+// 0 = no pacing beyond the swap interval
+double targetFps = 0.0;
+int framesInFlight = 2;
+// While nothing moves, redraw only for the slow ambient animation, at this
+// rate (0 = not at all until something moves). --no-idle draws every frame.
+bool idleRedraw = true;
+double idleFps = 20.0;
+// the window changed under the last frame; draw one even if the scene is idle
+bool windowDirty = false;
+// redraw every pixel every frame instead of only what changed
+bool fullRedraw = false;
+// draw opaque things front to back with a depth test, so hidden pixels aren't shaded
+bool earlyZ = true;
+// print how many fragments each pass shades
+bool countFragments = false;
+// translucent things (windows, text, Z letters) through weighted blended OIT
+// instead of blending in draw order; needs early-Z's depth buffer
+bool useOit = true;
+// overdraw heatmap instead of the scene (H toggles it)
+bool showHeatmap = false;
+// render in a hidden window and write the heatmap of the last frame here
+const char* heatmapImagePath = nullptr;
+// quit after this many frames (0 = run until closed)
+int frameLimit = 0;
+int dogCount = 1;
+int initialFood = 0;
+int birdCount = 0;
+int gpuDogCount = 0;
+// point lights drifting over the yard at night
+int fireflyCount = 0;
+// shadow quality: directions per light in the polar shadow maps (0 = no
+// shadows) and how much smaller than the window the occluder mask is
+int shadowResolution = 512;
+int shadowMaskDivisor = 2;
+int batchWorlds = 0;
+int threadCount = 0;
+bool simOnly = false;
+// 0 = the mode's default (12000 per batch world, 1000000 for --sim-only)
+int stepCount = 0;
+unsigned int worldSeed = 1;
+bool measureLatency = false;
+// input state kept up to date by the GLFW callbacks, so none of them has to query GLFW
+unsigned int heldKeys = 0;
+double cursorX = 0.0;
+double cursorY = 0.0;
+int windowWidth = SCR_WIDTH;
+int windowHeight = SCR_HEIGHT;
+// in pixels, which on high-DPI screens isn't the window size
+int framebufferWidth = SCR_WIDTH;
+int framebufferHeight = SCR_HEIGHT;
+const char* recordPath = nullptr;
+const char* replayPath = nullptr;
+
+// cached background layers, bottom first
+enum BackgroundLayer {
+    LAYER_SKY,
+    LAYER_SCENERY,
+    LAYER_WINDOWS,
+    LAYER_COUNT
+};
 
+// What a frame draws: the layer redraws (only when they're out of date), then
+// the frame itself in painter order, back to front.
+enum FramePass {
+    PASS_SKY_LAYER,
+    PASS_SCENERY_LAYER,
+    PASS_WINDOWS_LAYER,
+    PASS_BACKGROUND,
+    PASS_SUN,
+    PASS_BIRDS,
+    PASS_DOGS,
+    PASS_SMOKE,
+    PASS_SHADOWS,
+    PASS_LIGHTS,
+    PASS_TEXT,
+    PASS_Z,
+    PASS_FOOD,
+    PASS_COUNT
+};
+const char* passNames[PASS_COUNT] = { "sky", "scenery", "windows", "background", "sun", "birds", "dogs", "smoke",
+                                      "shadows", "lights", "text", "z", "food" };
+const int framePassCount = PASS_COUNT - PASS_BACKGROUND;
+const FramePass painterOrder[framePassCount] = { PASS_BACKGROUND, PASS_SUN, PASS_BIRDS, PASS_DOGS, PASS_SMOKE,
+                                                 PASS_SHADOWS, PASS_LIGHTS, PASS_TEXT, PASS_Z, PASS_FOOD };
+// the opaque passes front to back, then the blended ones (shadows, lights,
+// text and the Z letters) back to front
+const FramePass earlyZOrder[framePassCount] = { PASS_FOOD, PASS_SMOKE, PASS_DOGS, PASS_BIRDS, PASS_SUN,
+                                                PASS_BACKGROUND, PASS_SHADOWS, PASS_LIGHTS, PASS_TEXT, PASS_Z };
+
+// One mesh of a cached layer, drawn with the basic shader.
+struct LayerMesh {
+    unsigned int VAO;
+    GLenum mode;
+    int vertexCount;
+    bool fence;
+};
 
 unsigned int compileShader(GLenum shaderType, const char* source);
-unsigned int createShaderProgram(const char* vertexShaderSource, const char* fragmentShaderSource);
+unsigned int createShaderProgram(const char* vertexShaderSource, const char* fragmentShaderSource,
+                                 const char* sharedFragmentSource = nullptr);
 void framebufferSizeCallback(GLFWwindow* window, int width, int height);
-void processInput(GLFWwindow* window);
 void updateTreeBaseColors(float* treeBase, unsigned int VBO, float paintProgress);
-void calculateSunMoonPosition(float progress, float& sunX, float& sunY, float& moonX, float& moonY);
 void updateCircleVertices(float* vertices, float centerX, float centerY, float radius, float* color);
 void updateDayNightCycle(float& timeOfDay, float* skyColor, float& objectDimFactor, bool& isDay);
 void RenderTopRightText(unsigned int textShader, const std::string& text, float yOffset, float scale, glm::vec3 color);
 void RenderText(unsigned int shader, std::string text, float x, float y, float scale, glm::vec3 color);
 float CalculateTextWidth(const std::string& text, float scale);
-static unsigned loadImageToTexture(const char* filePath);
-float getDogCenter(float dogX, bool dogGoingLeft);
-void spawnFood(float x, float y);
+static void meshBounds(const float* vertices, int vertexCount, int stride, float* bounds);
+static float painterDepth(int index, int count);
+static void drawLayerMeshes(const LayerMesh* meshes, int count, int uDepthLoc, int isFenceLoc);
+struct DecodedImage {
+    unsigned char* pixels;
+    int width;
+    int height;
+    int channels;
+};
+static void decodeImage(const char* filePath, bool flip, int channels, DecodedImage& image);
+static unsigned uploadImageToTexture(const DecodedImage& image, const char* filePath);
 void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
-bool isClickOnGrass(float x, float y);
-void animateDog();
-float clip(float n, float lower, float upper);
+void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+void cursorPosCallback(GLFWwindow* window, double x, double y);
+void windowSizeCallback(GLFWwindow* window, int width, int height);
 
 struct Character {
     GLuint TextureID;
@@ -89,36 +182,144 @@ struct Character {
     unsigned int Advance;
 };
 
-struct ZLetter {
-    float startTime;
-    float xOffset;
-};
-vector<ZLetter> zLetters;
-float zSpawnInterval = 1.5f; // spawn a new "Z" every second
-float lastZSpawnTime = 0.0f;
-
-struct Food {
-    float x;
-    float y;
-    bool active;
-};
-Food food = { 0.0f, 0.0f, false };
-
-enum DogState {
-    DOG_IDLE,
-    DOG_MOVING_TO_FOOD,
-    DOG_EATING,
-    DOG_RETURNING
-};
-
-DogState dogState = DOG_IDLE;
+map<char, Character> Characters;
+unsigned int textVAO, textVBO;
 
+int main(int argc, char** argv) {
 
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--no-vsync") == 0) {
+            swapInterval = 0;
+        }
+        else if (strcmp(argv[i], "--dogs") == 0 && i + 1 < argc) {
+            dogCount = std::max(1, atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--birds") == 0 && i + 1 < argc) {
+            birdCount = std::max(0, atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--gpu-dogs") == 0 && i + 1 < argc) {
+            gpuDogCount = std::max(0, atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--fireflies") == 0 && i + 1 < argc) {
+            fireflyCount = std::max(0, atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--shadows") == 0 && i + 1 < argc) {
+            const char* quality = argv[++i];
+            if (strcmp(quality, "off") == 0) {
+                shadowResolution = 0;
+            }
+            else if (strcmp(quality, "low") == 0) {
+                shadowResolution = 256;
+                shadowMaskDivisor = 4;
+            }
+            else if (strcmp(quality, "medium") == 0) {
+                shadowResolution = 512;
+                shadowMaskDivisor = 2;
+            }
+            else if (strcmp(quality, "high") == 0) {
+                shadowResolution = 1024;
+                shadowMaskDivisor = 1;
+            }
+            else {
+                std::cerr << "Unknown shadow quality (off, low, medium or high): " << quality << std::endl;
+            }
+        }
+        else if (strcmp(argv[i], "--food") == 0 && i + 1 < argc) {
+            initialFood = std::max(0, atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batchWorlds = std::max(1, atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--steps") == 0 && i + 1 < argc) {
+            stepCount = std::max(1, atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--sim-only") == 0) {
+            simOnly = true;
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threadCount = std::max(0, atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--swap-interval") == 0 && i + 1 < argc) {
+            swapInterval = std::max(0, atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+            targetFps = std::max(0.0, atof(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc) {
+            framesInFlight = std::max(1, atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--idle-fps") == 0 && i + 1 < argc) {
+            idleFps = std::max(0.0, atof(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--no-idle") == 0) {
+            idleRedraw = false;
+        }
+        else if (strcmp(argv[i], "--full-redraw") == 0) {
+            fullRedraw = true;
+        }
+        else if (strcmp(argv[i], "--no-early-z") == 0) {
+            earlyZ = false;
+        }
+        else if (strcmp(argv[i], "--fragments") == 0) {
+            countFragments = true;
+        }
+        else if (strcmp(argv[i], "--no-oit") == 0) {
+            useOit = false;
+        }
+        else if (strcmp(argv[i], "--heatmap") == 0) {
+            showHeatmap = true;
+        }
+        else if (strcmp(argv[i], "--heatmap-image") == 0 && i + 1 < argc) {
+            heatmapImagePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frameLimit = std::max(0, atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--latency") == 0) {
+            measureLatency = true;
+        }
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            worldSeed = (unsigned int)strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            recordPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replayPath = argv[++i];
+        }
+    }
+    // without depth the translucent layer can't be kept behind opaque things drawn after it
+    useOit = useOit && earlyZ;
+    if (recordPath && replayPath) {
+        std::cerr << "--record and --replay can't be combined, not recording\n";
+        recordPath = nullptr;
+    }
 
-map<char, Character> Characters;
-unsigned int textVAO, textVBO;
+    // declared ahead of the job system so jobs still writing to them never outlive them on an early return
+    DecodedImage cursorImage = {};
+    DecodedImage characterImage = {};
+    JobCounter imagesDecoded;
+    JobSystem jobs(threadCount);
 
-int main() {
+    InputLog inputLog = {};
+    if (replayPath && !loadInputLog(inputLog, replayPath)) {
+        return 4;
+    }
+    if (simOnly && replayPath) {
+        printReplayResult(runReplay(jobs, inputLog));
+        printJobTimings(jobs);
+        return 0;
+    }
+    if (simOnly) {
+        printSimOnlyResult(runSimOnly(jobs, dogCount, birdCount, initialFood, stepCount > 0 ? stepCount : 1000000));
+        printJobTimings(jobs);
+        return 0;
+    }
+    if (batchWorlds > 0) {
+        printBatchResult(runWorldBatch(jobs, batchWorlds, dogCount, stepCount > 0 ? stepCount : 12000));
+        printJobTimings(jobs);
+        return 0;
+    }
 
     // Initialize GLFW
     if (!glfwInit()) {
@@ -130,6 +331,15 @@ int main() {
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    if (heatmapImagePath) {
+        // nothing to look at: render offscreen, save the image and quit
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        showHeatmap = true;
+        idleRedraw = false;
+        if (frameLimit == 0) {
+            frameLimit = 120;
+        }
+    }
 
     // Create GLFW window
     GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, WINDOW_TITLE, nullptr, nullptr);
@@ -140,8 +350,13 @@ int main() {
     }
 
     glfwMakeContextCurrent(window);
+    glfwSwapInterval(swapInterval);
     glfwSetMouseButtonCallback(window, mouseButtonCallback);
+    glfwSetKeyCallback(window, keyCallback);
+    glfwSetCursorPosCallback(window, cursorPosCallback);
+    glfwSetWindowSizeCallback(window, windowSizeCallback);
     glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
 
     // Initialize GLEW
     if (glewInit() != GLEW_OK) {
@@ -149,28 +364,9 @@ int main() {
         return 3;
     }
 
-    int width, height, channels;
-    unsigned char* pixels = stbi_load("res/bone.png", &width, &height, &channels, 4);
-    if (!pixels) {
-        std::cerr << "Failed to load cursor image\n";
-        return -1;
-    }
-
-    GLFWimage image;
-    image.width = width;
-    image.height = height;
-    image.pixels = pixels;
-
-    GLFWcursor* cursor = glfwCreateCursor(&image, width / 2, height / 2); // Hotspot at center
-    if (!cursor) {
-        std::cerr << "Failed to create GLFW cursor\n";
-        stbi_image_free(pixels);
-        glfwTerminate();
-        return -1;
-    }
-
-    glfwSetCursor(window, cursor);
-    stbi_image_free(pixels);
+    // decode the images on the job system while FreeType and the shaders load
+    jobs.run("decode.image", [&] { decodeImage("res/bone.png", false, 4, cursorImage); }, &imagesDecoded);
+    jobs.run("decode.image", [&] { decodeImage("res/walter.png", true, 0, characterImage); }, &imagesDecoded);
 
     // Initialize FreeType
     FT_Library ft;
@@ -234,11 +430,35 @@ int main() {
     unsigned int sunShader = createShaderProgram("sun.vert", "sun.frag");
     unsigned int dogShader = createShaderProgram("dog.vert", "dog.frag");
     unsigned int smokeShader = createShaderProgram("smoke.vert", "smoke.frag");
-    unsigned int textShader = createShaderProgram("text.vert", "text.frag");
-    unsigned int windowShader = createShaderProgram("window.vert", "window.frag");
-    unsigned int zShader = createShaderProgram("z.vert", "z.frag");
+    unsigned int textShader = createShaderProgram("text.vert", "text.frag", "oit_write.frag");
+    unsigned int windowShader = createShaderProgram("window.vert", "window.frag", "oit_write.frag");
+    unsigned int zShader = createShaderProgram("z.vert", "z.frag", "oit_write.frag");
     unsigned int foodShader = createShaderProgram("food.vert", "food.frag");
-    unsigned int characterTexture = loadImageToTexture("res/walter.png");
+    unsigned int birdShader = createShaderProgram("bird.vert", "bird.frag");
+    jobs.wait(imagesDecoded);
+
+    if (!cursorImage.pixels) {
+        std::cerr << "Failed to load cursor image\n";
+        return -1;
+    }
+
+    GLFWimage image;
+    image.width = cursorImage.width;
+    image.height = cursorImage.height;
+    image.pixels = cursorImage.pixels;
+
+    GLFWcursor* cursor = glfwCreateCursor(&image, cursorImage.width / 2, cursorImage.height / 2); // Hotspot at center
+    if (!cursor) {
+        std::cerr << "Failed to create GLFW cursor\n";
+        stbi_image_free(cursorImage.pixels);
+        glfwTerminate();
+        return -1;
+    }
+
+    glfwSetCursor(window, cursor);
+    stbi_image_free(cursorImage.pixels);
+
+    unsigned int characterTexture = uploadImageToTexture(characterImage, "res/walter.png");
 
     if (!characterTexture) {
         std::cerr << "Failed to load characterr texture!" << std::endl;
@@ -981,9 +1201,11 @@ int main() {
         -0.538f,  -0.595f,  0.0f,   0.949f, 0.749f, 0.941f,
         -0.538f,  -0.618f,  0.0f,   0.949f, 0.749f, 0.941f,
     };
-    unsigned int dogVAO, dogVBO;
+    // attribute 2 is per CPU dog: x, y and flip, filled from the snapshot every frame
+    unsigned int dogVAO, dogVBO, dogInstanceVBO;
     glGenVertexArrays(1, &dogVAO);
     glGenBuffers(1, &dogVBO);
+    glGenBuffers(1, &dogInstanceVBO);
 
     glBindVertexArray(dogVAO);
 
@@ -996,6 +1218,43 @@ int main() {
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
     glEnableVertexAttribArray(1);
 
+    glBindBuffer(GL_ARRAY_BUFFER, dogInstanceVBO);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+
+    glBindVertexArray(0);
+
+    float birdCorners[] = {
+        -1.0f, -1.0f,
+         1.0f, -1.0f,
+         1.0f,  1.0f,
+
+        -1.0f, -1.0f,
+         1.0f,  1.0f,
+        -1.0f,  1.0f,
+    };
+    // attribute 0 is the shared quad, 1-4 are per-bird prevX, prevY, x, y (one buffer each)
+    unsigned int birdVAO, birdVBO;
+    unsigned int birdInstanceVBOs[4];
+    glGenVertexArrays(1, &birdVAO);
+    glGenBuffers(1, &birdVBO);
+    glGenBuffers(4, birdInstanceVBOs);
+
+    glBindVertexArray(birdVAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, birdVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(birdCorners), birdCorners, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    for (int i = 0; i < 4; ++i) {
+        glBindBuffer(GL_ARRAY_BUFFER, birdInstanceVBOs[i]);
+        glVertexAttribPointer(1 + i, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void*)0);
+        glEnableVertexAttribArray(1 + i);
+        glVertexAttribDivisor(1 + i, 1);
+    }
+
     glBindVertexArray(0);
 
     float foodVertices[] = {
@@ -1008,9 +1267,11 @@ int main() {
          0.01f,  0.015f, 0.0f,   1.0f, 0.5f, 0.0f, // top right
         -0.01f,  0.015f, 0.0f,   1.0f, 0.5f, 0.0f  // top left
     };
-    unsigned int foodVAO, foodVBO;
+    // attribute 2 is per item: x and y, filled from the snapshot every frame
+    unsigned int foodVAO, foodVBO, foodInstanceVBO;
     glGenVertexArrays(1, &foodVAO);
     glGenBuffers(1, &foodVBO);
+    glGenBuffers(1, &foodInstanceVBO);
 
     glBindVertexArray(foodVAO);
 
@@ -1023,6 +1284,11 @@ int main() {
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float))); // colors
     glEnableVertexAttribArray(1);
 
+    glBindBuffer(GL_ARRAY_BUFFER, foodInstanceVBO);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+
     glBindVertexArray(0);
 
 
@@ -1035,9 +1301,11 @@ int main() {
 			 0.05f,  0.1f, 0.0f,   1.0f, 1.0f, 
 			-0.05f,  0.1f, 0.0f,   0.0f, 1.0f  
     };
-    unsigned int zVAO, zVBO;
+    // attribute 2 is per letter: x, y and alpha, filled from the Z curves every frame
+    unsigned int zVAO, zVBO, zInstanceVBO;
     glGenVertexArrays(1, &zVAO);
     glGenBuffers(1, &zVBO);
+    glGenBuffers(1, &zInstanceVBO);
 
     glBindVertexArray(zVAO);
 
@@ -1050,6 +1318,11 @@ int main() {
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float))); 
     glEnableVertexAttribArray(1);
 
+    glBindBuffer(GL_ARRAY_BUFFER, zInstanceVBO);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+
     glBindVertexArray(0);
 
     float rectangleVertices[] = {
@@ -1123,11 +1396,10 @@ int main() {
     glBindVertexArray(0);
 
 
-    float sunX, sunY, moonX, moonY;
-
     int uHLoc = glGetUniformLocation(shaderProgram, "uH");
     int isFenceLoc = glGetUniformLocation(shaderProgram, "isFence");
     int dimLoc = glGetUniformLocation(shaderProgram, "dim");
+    int uDepthLoc = glGetUniformLocation(shaderProgram, "uDepth");
 
     int uWindowAlpha = glGetUniformLocation(windowShader, "uAlpha");
     int uWindowTransparent = glGetUniformLocation(windowShader, "uTransparent");
@@ -1140,280 +1412,754 @@ int main() {
     int uUseTextureLoc = glGetUniformLocation(windowShader, "uUseTexture");
     int uCharacterTextureLoc = glGetUniformLocation(windowShader, "uCharacterTexture");
 
-    int uPosLoc = glGetUniformLocation(dogShader, "uPos");
-    int uFlipLoc = glGetUniformLocation(dogShader, "uFlip");
+    int uFromStateLoc = glGetUniformLocation(dogShader, "uFromState");
+    int uPrevStateLoc = glGetUniformLocation(dogShader, "uPrevState");
+    int uStateLoc = glGetUniformLocation(dogShader, "uState");
+    int uAlphaLocDog = glGetUniformLocation(dogShader, "uAlpha");
+
+    int uPulseLoc = glGetUniformLocation(windowShader, "uPulse");
 
     int uTimeLocSmoke = glGetUniformLocation(smokeShader, "uTime");
     int uOriginLocSmoke = glGetUniformLocation(smokeShader, "uOrigin");
+    int uRiseLocSmoke = glGetUniformLocation(smokeShader, "uRise");
 
     int uTimeLocZ = glGetUniformLocation(zShader, "uTime");
     int uColorLocZ = glGetUniformLocation(zShader, "uColor");
-    int uStartTimeLocZ = glGetUniformLocation(zShader, "uStartTime");
-    int uOriginLocZ = glGetUniformLocation(zShader, "uOrigin");
     int uTextureLocZ = glGetUniformLocation(zShader, "uTexture");
 
+    int uAlphaLocBird = glGetUniformLocation(birdShader, "uAlpha");
+    int uSizeLocBird = glGetUniformLocation(birdShader, "uSize");
+    int uDimLocBird = glGetUniformLocation(birdShader, "uDim");
+
     glUniform1i(uHLoc, SCR_HEIGHT);
     glUseProgram(shaderProgram);
-    glUniform1f(dimLoc, dimFactor);
-
-    while (!glfwWindowShouldClose(window)) {
-        processInput(window);
-        updateTreeBaseColors(treeBase, treebaseVBO, paintProgress);
-        float dogSleepTime = glfwGetTime();
-
-        if (transitionInProgress) {
-            float currentTime = glfwGetTime();
-            sunMoonProgress = (dogSleepTime - transitionStartTime) / transitionDuration;
-            if (sunMoonProgress >= 1.0f) {
-                sunMoonProgress = 1.0f;
-                transitionInProgress = false;
-                isDay = !isDay;
-            }
-        }
-        else {
-            sunMoonProgress = 0.0f;
-        }
-
-        if (isDay) {
-            dimFactor = 1.0f - 0.5f * sunMoonProgress;
-            zLetters.clear();
-            lastZSpawnTime = dogSleepTime;
-        }
-        else {
-            dimFactor = 0.5f + 0.5f * sunMoonProgress;
-			if (dogSleepTime - lastZSpawnTime >= zSpawnInterval) {
-				ZLetter newZ;
-				newZ.startTime = dogSleepTime;
-				newZ.xOffset = ((rand() % 100) / 100.0f - 0.5f) * 0.04f; // Random horizontal offset
-				zLetters.push_back(newZ);
-				lastZSpawnTime = dogSleepTime;
-			}
+    glUniform1f(dimLoc, 1.0f);
+
+    // Animation tracks over time. Z letters sample theirs by age, all letters in one batch.
+    Curve zRise;
+    zRise.key(0.0f, 0.0f, 0.08f).key(2.0f, 0.1f, 0.02f);
+    Curve zAlpha;
+    zAlpha.key(0.0f, 0.0f, 8.0f).key(0.25f, 1.0f).bezierTo(1.0f, 0.3f, 2.0f, 0.0f);
+    // smoke puffs up for half of a 21 s cycle and rests for the other half
+    Curve smokeRise;
+    smokeRise.key(0.0f, 0.0f, 0.03f).key(5.236f, 0.1f).key(10.472f, 0.0f, -0.03f, 0.0f).key(20.944f, 0.0f).looping();
+    Curve lightPulse;
+    lightPulse.key(0.0f, 0.5f, 1.5f).key(0.5236f, 1.0f).key(1.0472f, 0.5f, -1.5f).key(1.5708f, 0.0f).key(2.0944f, 0.5f, 1.5f).looping();
+    std::vector<float> zAges;
+    std::vector<float> zInstances;
+    std::vector<float> dogInstances;
+    std::vector<float> foodInstances;
+
+    SteadyClock clock;
+    if (replayPath) {
+        initSimulation(inputLog.dogCount, inputLog.birdCount, inputLog.seed, jobs);
+        replayInput(inputLog);
+    }
+    else {
+        initSimulation(dogCount, birdCount, worldSeed, jobs);
+        if (recordPath) {
+            inputLog.seed = worldSeed;
+            inputLog.dogCount = dogCount;
+            inputLog.birdCount = birdCount;
+            recordInput(inputLog);
         }
+    }
+    startSimulationThread(clock);
+
+    // GPU dogs live on the render thread (they need the context) and step on their own fixed-step clock
+    unsigned int agentUpdateShader = 0;
+    GpuAgents* gpuAgents = nullptr;
+    FixedStepper gpuStepper(clock, simTimestep);
+    float gpuTime = 0.0f;
+    if (gpuDogCount > 0) {
+        agentUpdateShader = createShaderProgram("agent_update.vert", "agent_update.frag");
+        gpuAgents = new GpuAgents(gpuDogCount, agentUpdateShader);
+    }
 
+    LatencyStats latency;
+    unsigned int lastInputSerial = 0;
+    // fences are GL objects: deleted with the other GL state, before the context goes
+    FramePacer* pacer = new FramePacer(clock, targetFps, framesInFlight);
+    // the simulation wakes the loop below out of its idle wait when something moves
+    setSceneChangedCallback(glfwPostEmptyEvent);
+    double lastFrameStart = -1.0;
+
+    // sky, house, tree and windows are only redrawn when they change
+    unsigned int layerShader = createShaderProgram("layer.vert", "layer.frag");
+    LayerCache* layers = new LayerCache(LAYER_COUNT, layerShader);
+    // the windows all sit within this part of the house
+    layers->setBounds(LAYER_WINDOWS, -0.25f, -0.38f, 0.25f, 0.1f);
+
+    // and the rest of the frame only where something moved or animates
+    unsigned int damageMaskShader = createShaderProgram("damage_mask.vert", "damage_mask.frag");
+    RetainedFrame* retained = new RetainedFrame(damageMaskShader);
+    DamageTracker damage;
+    // where the moving things' meshes reach around their origin
+    float dogBounds[4];
+    float dogFlippedBounds[4];
+    float smokeBounds[4];
+    float zBounds[4];
+    float foodBounds[4];
+    meshBounds(dog, sizeof(dog) / (6 * sizeof(float)), 6, dogBounds);
+    // dog.vert mirrors a facing-left dog around dogCenter.x
+    const float dogCenterX = -0.65f;
+    dogFlippedBounds[0] = 2.0f * dogCenterX - dogBounds[2];
+    dogFlippedBounds[1] = dogBounds[1];
+    dogFlippedBounds[2] = 2.0f * dogCenterX - dogBounds[0];
+    dogFlippedBounds[3] = dogBounds[3];
+    meshBounds(chimneySmoke, 6, 6, smokeBounds);
+    meshBounds(zVerticies, 6, 5, zBounds);
+    meshBounds(foodVertices, 6, 6, foodBounds);
+
+    // the layers' meshes in painter order, back to front
+    const LayerMesh skyMeshes[2] = {
+        { skyVAO, GL_TRIANGLES, 6, false },
+        { moonVAO, GL_TRIANGLE_FAN, ELLIPSE_SEGMENTS + 2, false }
+    };
+    const LayerMesh sceneryMeshes[] = {
+        { rectangleVAO, GL_TRIANGLES, 6, true },
+        { housebaseVAO, GL_TRIANGLES, 6, false },
+        { firstfloorVAO, GL_TRIANGLES, 6, false },
+        { firstroofVAO, GL_TRIANGLES, 6, false },
+        { secondfloorVAO, GL_TRIANGLES, 6, false },
+        { secondroofVAO, GL_TRIANGLES, 3, false },
+        { secondroofleftVAO, GL_TRIANGLES, 3, false },
+        { secondroofleftVAO, GL_TRIANGLES, 6, false },
+        { secondroofrightVAO, GL_TRIANGLES, 6, false },
+        { chimneyVAO, GL_TRIANGLES, 6, false },
+        { doorVAO, GL_TRIANGLES, 6, false },
+        { handleVAO, GL_TRIANGLES, 3, false },
+        { doghousebaseVAO, GL_TRIANGLES, 6, false },
+        { doghouseroofVAO, GL_TRIANGLES, 6, false },
+        { treebaseVAO, GL_TRIANGLES, 6, false },
+        { ellipseVAO, GL_TRIANGLE_FAN, ELLIPSE_SEGMENTS + 2, false }
+    };
+    const int sceneryMeshCount = sizeof(sceneryMeshes) / sizeof(sceneryMeshes[0]);
+
+    // night lights: the lit window and the fireflies, culled per screen tile
+    unsigned int lightShader = createShaderProgram("layer.vert", "light.frag");
+    LightGrid* lightGrid = new LightGrid(lightShader);
+    std::vector<PointLight> lights;
+    float windowCenters[7][2];
+    const float* windowMeshes[7] = { win1, win2, win3, win4, win5, win6, win7 };
+    for (int i = 0; i < 7; ++i) {
+        float bounds[4];
+        meshBounds(windowMeshes[i], 6, 8, bounds);
+        windowCenters[i][0] = (bounds[0] + bounds[2]) * 0.5f;
+        windowCenters[i][1] = (bounds[1] + bounds[3]) * 0.5f;
+    }
+    // per firefly: home position, drift phase and speed, flicker phase
+    std::vector<float> fireflies(fireflyCount * 5);
+    Pcg32 fireflyRandom(worldSeed);
+    for (int i = 0; i < fireflyCount; ++i) {
+        fireflies[i * 5] = fireflyRandom.unit() * 2.0f - 1.0f;
+        fireflies[i * 5 + 1] = fireflyRandom.unit() * 1.2f - 0.9f;
+        fireflies[i * 5 + 2] = fireflyRandom.unit() * 6.2832f;
+        fireflies[i * 5 + 3] = 0.3f + fireflyRandom.unit() * 0.7f;
+        fireflies[i * 5 + 4] = fireflyRandom.unit() * 6.2832f;
+    }
 
-        calculateSunMoonPosition(sunMoonProgress, sunX, sunY, moonX, moonY);
+    // soft shadows of the house, tree, doghouse and dogs, from the sun or moon and the lit window
+    unsigned int shadowMapShader = createShaderProgram("layer.vert", "shadow_map.frag");
+    unsigned int shadowApplyShader = createShaderProgram("shadow_apply.vert", "shadow_apply.frag");
+    ShadowMaps* shadows = shadowResolution > 0
+        ? new ShadowMaps(shadowMapShader, shadowApplyShader, shadowResolution, shadowMaskDivisor) : nullptr;
+    std::vector<ShadowLight> shadowLights;
+    // what the shadows were last built from; they're only rebuilt (and the ground redrawn) when it changes
+    std::vector<float> shadowKey;
+    std::vector<float> lastShadowKey;
+
+    // Each frame pass draws at its own depth, later ones nearer, so the depth
+    // test keeps painter order whichever order the passes are drawn in.
+    const unsigned int passShaders[framePassCount] = { layerShader, sunShader, birdShader, dogShader, smokeShader,
+                                                       shadowApplyShader, lightShader, textShader, zShader, foodShader };
+    for (int i = 0; i < framePassCount; ++i) {
+        glUseProgram(passShaders[i]);
+        glUniform1f(glGetUniformLocation(passShaders[i], "uDepth"), painterDepth(i, framePassCount));
+    }
+    glUseProgram(0);
+    FragmentCounter* fragments = countFragments ? new FragmentCounter(PASS_COUNT) : nullptr;
+    // the heatmap's fullscreen triangle is the same as the layers'
+    unsigned int heatmapShader = createShaderProgram("layer.vert", "heatmap.frag");
+    OverdrawHeatmap* heatmap = new OverdrawHeatmap(heatmapShader);
+    // the translucent shaders write either the OIT targets or the frame, for the whole run
+    unsigned int oitResolveShader = createShaderProgram("layer.vert", "oit_resolve.frag");
+    WeightedOit* oit = new WeightedOit(oitResolveShader);
+    const unsigned int translucentShaders[3] = { windowShader, textShader, zShader };
+    for (int i = 0; i < 3; ++i) {
+        glUseProgram(translucentShaders[i]);
+        glUniform1i(glGetUniformLocation(translucentShaders[i], "uOit"), useOit);
+    }
+    glUseProgram(0);
+    bool heatmapShown = false;
+    int framesDrawn = 0;
 
-        for (int i = 0; i < 3; ++i) {
-            if (isDay) {
-                skyColor[i] = daySkyColor[i] * (1.0f - sunMoonProgress) + nightSkyColor[i] * sunMoonProgress;
-            }
-            else {
-                skyColor[i] = nightSkyColor[i] * (1.0f - sunMoonProgress) + daySkyColor[i] * sunMoonProgress;
+    // for the frame and, as occluders, for the shadows
+    auto drawDogs = [&](const SceneSnapshot& snapshot, float alpha) {
+        glUseProgram(dogShader);
+        glBindVertexArray(dogVAO);
+        size_t cpuDogs = snapshot.dogX.size();
+        if (cpuDogs > 0) {
+            dogInstances.resize(cpuDogs * 3);
+            for (size_t i = 0; i < cpuDogs; ++i) {
+                dogInstances[i * 3] = lerp(snapshot.dogPrevX[i], snapshot.dogX[i], alpha);
+                dogInstances[i * 3 + 1] = lerp(snapshot.dogPrevY[i], snapshot.dogY[i], alpha);
+                dogInstances[i * 3 + 2] = (snapshot.dogSprite[i] & SPRITE_FLIP) ? 1.0f : 0.0f;
             }
+            glBindBuffer(GL_ARRAY_BUFFER, dogInstanceVBO);
+            glBufferData(GL_ARRAY_BUFFER, dogInstances.size() * sizeof(float), dogInstances.data(), GL_STREAM_DRAW);
+            glDrawArraysInstanced(GL_TRIANGLES, 0, 42, (GLsizei)cpuDogs);
         }
-
-        for (int i = 0; i < 6; ++i) {
-            sky[i * 6 + 3] = skyColor[0];
-            sky[i * 6 + 4] = skyColor[1];
-            sky[i * 6 + 5] = skyColor[2];
+        if (gpuAgents) {
+            // these read the state textures, and there are more of them than CPU dogs in the instance buffer
+            glDisableVertexAttribArray(2);
+            glUniform1i(uFromStateLoc, GL_TRUE);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, gpuAgents->previousStateTexture());
+            glUniform1i(uPrevStateLoc, 0);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, gpuAgents->currentStateTexture());
+            glUniform1i(uStateLoc, 1);
+            glUniform1f(uAlphaLocDog, snapshot.isDay ? (float)gpuStepper.interpolation() : 1.0f);
+            glDrawArraysInstanced(GL_TRIANGLES, 0, 42, gpuAgents->count());
+            glEnableVertexAttribArray(2);
+            glUniform1i(uFromStateLoc, GL_FALSE);
+            glActiveTexture(GL_TEXTURE0);
         }
+        glBindVertexArray(0);
+        glUseProgram(0);
+    };
 
-        if (isDay) {
-            animateDog();
+    while (!glfwWindowShouldClose(window)) {
+        if (idleRedraw && !(gpuAgents && latestSnapshot().isDay)) {
+            acquireLatestSnapshot();
+            // The last change is fully on screen once a frame started after its
+            // step was done interpolating; from then on only the ambient animation moves.
+            double settled = latestSnapshot().changeTime + simTimestep;
+            if (lastFrameStart > settled && !windowDirty) {
+                if (idleFps == 0.0) {
+                    pacer->idled();
+                    glfwWaitEvents();
+                    continue;
+                }
+                double wait = lastFrameStart + 1.0 / idleFps - simClockNow();
+                if (wait > 0.0) {
+                    pacer->idled();
+                    glfwWaitEventsTimeout(wait);
+                    continue;
+                }
+            }
         }
 
+        pacer->waitForFrameStart();
+        lastFrameStart = simClockNow();
+        windowDirty = false;
+        // H can flip showHeatmap in the late-latch poll; the frame sticks with what it started with
+        const bool heatmapFrame = showHeatmap;
+        // the heatmap shows the per-pass counts, so it brings a counter along while it's up
+        if (heatmapFrame && !fragments) {
+            fragments = new FragmentCounter(PASS_COUNT);
+        }
+        else if (!heatmapFrame && heatmapShown && !countFragments) {
+            fragments->print("Fragments shaded while the heatmap was up", passNames);
+            delete fragments;
+            fragments = nullptr;
+        }
+        acquireLatestSnapshot();
+        const SceneSnapshot& scene = latestSnapshot();
+        float alpha = clip((float)((simClockNow() - scene.publishTime) / simTimestep), 0.0f, 1.0f);
+        RenderState frame = interpolateRenderState(scene.previous, scene.current, alpha);
+
+        if (gpuAgents) {
+            int steps = gpuStepper.stepsDue(maxFrameTime);
+            for (int i = 0; i < steps; ++i) {
+                gpuTime += (float)simTimestep;
+                // like the CPU dogs, they sleep through the night
+                if (scene.isDay) {
+                    gpuAgents->step((float)simTimestep, gpuTime);
+                }
+            }
+        }
 
-        glBindBuffer(GL_ARRAY_BUFFER, skyVBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(sky), sky);
-
-
-        glBindBuffer(GL_ARRAY_BUFFER, skyVBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(sky), sky);
-
-        glBindBuffer(GL_ARRAY_BUFFER, housebaseVBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(houseBase), houseBase);
-
-        updateCircleVertices(sunVertices, sunX, sunY, 0.1f, sunColor);
-        updateCircleVertices(moonVertices, moonX, moonY, 0.1f, moonColor);
-
-        glBindBuffer(GL_ARRAY_BUFFER, sunVBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(sunVertices), sunVertices);
-
-        glBindBuffer(GL_ARRAY_BUFFER, moonVBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(moonVertices), moonVertices);
-
-        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
-
-        glUseProgram(shaderProgram);
-        glUniform1f(isFenceLoc, GL_FALSE);
-        glBindVertexArray(skyVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-
-        glUniform1f(isFenceLoc, GL_TRUE);
-        glBindVertexArray(rectangleVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-
-        glUniform1f(isFenceLoc, GL_FALSE);
-        glBindVertexArray(housebaseVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-
-        glUniform1f(isFenceLoc, GL_FALSE);
-        glBindVertexArray(firstfloorVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-
-        glUniform1f(isFenceLoc, GL_FALSE);
-        glBindVertexArray(firstroofVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-
-        glUniform1f(isFenceLoc, GL_FALSE);
-        glBindVertexArray(secondfloorVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-
-        glUniform1f(isFenceLoc, GL_FALSE);
-        glBindVertexArray(secondroofVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 3);
-
-        glUniform1f(isFenceLoc, GL_FALSE);
-        glBindVertexArray(secondroofleftVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 3);
-
-        glUniform1f(isFenceLoc, GL_FALSE);
-        glBindVertexArray(secondroofleftVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-
-        glUniform1f(isFenceLoc, GL_FALSE);
-        glBindVertexArray(secondroofrightVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-
-        glUniform1f(isFenceLoc, GL_FALSE);
-        glBindVertexArray(chimneyVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-
-        glUniform1f(isFenceLoc, GL_FALSE);
-        glBindVertexArray(doorVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-
-        glUniform1f(isFenceLoc, GL_FALSE);
-        glBindVertexArray(handleVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 3);
-
-
-        glUniform1f(isFenceLoc, GL_FALSE);
-        glBindVertexArray(doghousebaseVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        glUniform1f(isFenceLoc, GL_FALSE);
-        glBindVertexArray(doghouseroofVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-
-        glUniform1f(isFenceLoc, GL_FALSE);
-        glBindVertexArray(treebaseVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-
-        glUniform1f(isFenceLoc, GL_FALSE);
-        glBindVertexArray(ellipseVAO);
-        glDrawArrays(GL_TRIANGLE_FAN, 0, ELLIPSE_SEGMENTS + 2);
-
-        glUniform1f(isFenceLoc, GL_FALSE);
-        glBindVertexArray(moonVAO);
-        glDrawArrays(GL_TRIANGLE_FAN, 0, ELLIPSE_SEGMENTS + 2);
+        layers->resize(framebufferWidth, framebufferHeight);
+        oit->resize(framebufferWidth, framebufferHeight);
 
-        glUseProgram(sunShader);
-        glUniform1f(glGetUniformLocation(sunShader, "time"), glfwGetTime());
-        glBindVertexArray(sunVAO);
-        glDrawArrays(GL_TRIANGLE_FAN, 0, ELLIPSE_SEGMENTS + 2);
+        float skyKey[5] = { frame.skyColor[0], frame.skyColor[1], frame.skyColor[2], frame.moonX, frame.moonY };
+        if (layers->needsRedraw(LAYER_SKY, skyKey, 5)) {
+            for (int i = 0; i < 6; ++i) {
+                sky[i * 6 + 3] = frame.skyColor[0];
+                sky[i * 6 + 4] = frame.skyColor[1];
+                sky[i * 6 + 5] = frame.skyColor[2];
+            }
+            glBindBuffer(GL_ARRAY_BUFFER, skyVBO);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(sky), sky);
 
+            updateCircleVertices(moonVertices, frame.moonX, frame.moonY, 0.1f, moonColor);
+            glBindBuffer(GL_ARRAY_BUFFER, moonVBO);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(moonVertices), moonVertices);
 
-        glUseProgram(windowShader);
-        glUniform1f(glGetUniformLocation(windowShader, "uTime"), glfwGetTime());
+            layers->beginLayer(LAYER_SKY);
+            if (fragments) {
+                fragments->beginPass(PASS_SKY_LAYER);
+            }
+            // the ground is whatever the sky quad leaves uncovered
+            glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+
+            glUseProgram(shaderProgram);
+            drawLayerMeshes(skyMeshes, 2, uDepthLoc, isFenceLoc);
+            if (fragments) {
+                fragments->endPass();
+            }
+            layers->endLayer();
+        }
 
-        for (int i = 0; i < 7; ++i) {
-            glUniform1i(uRoomIndexLoc, i);
-            glUniform1i(uSelectedRoomLoc, selectedRoom);
-            glUniform1f(uWindowAlpha, transparencyEnabled ? 0.5f : 1.0f);
-            glUniform1i(uWindowTransparent, transparencyEnabled ? GL_TRUE : GL_FALSE); 
-            glUniform1i(uLightEnabledLoc, lightEnabled);
-            glUniform1f(uTransitionProgressLoc, sunMoonProgress);
-            glUniform3f(lightStartColorLoc, 1.0f, 1.0f, 0.0f);
-            glUniform3f(lightEndColorLoc, 1.0f, 0.5f, 0.0f);
+        float sceneryKey[1] = { scene.paintProgress };
+        if (layers->needsRedraw(LAYER_SCENERY, sceneryKey, 1)) {
+            updateTreeBaseColors(treeBase, treebaseVBO, scene.paintProgress);
 
-            if (transparencyEnabled && selectedRoom == i) {
-                glUniform1i(uUseTextureLoc, GL_TRUE);
-                glActiveTexture(GL_TEXTURE0);
-                glBindTexture(GL_TEXTURE_2D, characterTexture);
-                glUniform1i(uCharacterTextureLoc, 0);
+            layers->beginLayer(LAYER_SCENERY);
+            if (fragments) {
+                fragments->beginPass(PASS_SCENERY_LAYER);
             }
-            else {
-                glUniform1i(uUseTextureLoc, GL_FALSE);
+            glUseProgram(shaderProgram);
+            drawLayerMeshes(sceneryMeshes, sceneryMeshCount, uDepthLoc, isFenceLoc);
+            if (fragments) {
+                fragments->endPass();
             }
-
-            glBindVertexArray(winVAOs[i]);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
+            layers->endLayer();
         }
 
+        // the pulse only shows on the lit window, so an unlit house is cached like the rest
+        float windowKey[4] = { (float)scene.selectedRoom, scene.transparencyEnabled ? 1.0f : 0.0f,
+                               scene.lightEnabled ? 1.0f : 0.0f, scene.lightEnabled ? lightPulse.sample(frame.time) : 0.0f };
+        if (layers->needsRedraw(LAYER_WINDOWS, windowKey, 4)) {
+            layers->beginLayer(LAYER_WINDOWS);
+            if (fragments) {
+                fragments->beginPass(PASS_WINDOWS_LAYER);
+            }
+            // no depth: the windows are all there is in their layer
+            if (useOit) {
+                oit->begin(0);
+            }
+            glUseProgram(windowShader);
+            glUniform1f(uPulseLoc, windowKey[3]);
+
+            for (int i = 0; i < 7; ++i) {
+                glUniform1i(uRoomIndexLoc, i);
+                glUniform1i(uSelectedRoomLoc, scene.selectedRoom);
+                glUniform1f(uWindowAlpha, scene.transparencyEnabled ? 0.5f : 1.0f);
+                glUniform1i(uWindowTransparent, scene.transparencyEnabled ? GL_TRUE : GL_FALSE); 
+                glUniform1i(uLightEnabledLoc, scene.lightEnabled);
+                glUniform1f(uTransitionProgressLoc, scene.sunMoonProgress);
+                glUniform3f(lightStartColorLoc, 1.0f, 1.0f, 0.0f);
+                glUniform3f(lightEndColorLoc, 1.0f, 0.5f, 0.0f);
+
+                if (scene.transparencyEnabled && scene.selectedRoom == i) {
+                    glUniform1i(uUseTextureLoc, GL_TRUE);
+                    glActiveTexture(GL_TEXTURE0);
+                    glBindTexture(GL_TEXTURE_2D, characterTexture);
+                    glUniform1i(uCharacterTextureLoc, 0);
+                }
+                else {
+                    glUniform1i(uUseTextureLoc, GL_FALSE);
+                }
+
+                glBindVertexArray(winVAOs[i]);
+                glDrawArrays(GL_TRIANGLES, 0, 6);
+            }
+            if (useOit) {
+                oit->resolve();
+            }
+            if (fragments) {
+                fragments->endPass();
+            }
+            layers->endLayer();
+        }
 
-        glUseProgram(dogShader);
-        glUniform2f(uPosLoc, dogX, dogY);
-        glUniform1i(uFlipLoc, dogGoingLeft);
-        glBindVertexArray(dogVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 42);
-        glBindVertexArray(0);
-        glUseProgram(0);
-
-        glUseProgram(smokeShader);
-        float currentTime = glfwGetTime();
-        glUniform1f(uTimeLocSmoke, currentTime);
-        glUniform2f(uOriginLocSmoke, 0.125f, 0.33f);
-        glBindVertexArray(smokeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        glBindVertexArray(0);
+        // Late latch: input that came in and steps the simulation finished while
+        // the background layers were brought up to date still make it into this frame.
+        glfwPollEvents();
+        acquireLatestSnapshot();
+        const SceneSnapshot& latest = latestSnapshot();
+        alpha = clip((float)((simClockNow() - latest.publishTime) / simTimestep), 0.0f, 1.0f);
+
+        // frame.time is from before the latch; the letters below may be from a newer step
+        float currentTime = lerp(latest.previous.time, latest.current.time, alpha);
+        float smokeRiseNow = smokeRise.sample(currentTime);
+        size_t zCount = latest.zX.size();
+        if (zCount > 0) {
+            zAges.resize(zCount);
+            zInstances.resize(zCount * 3);
+            for (size_t i = 0; i < zCount; ++i) {
+                // a letter spawned in the step being interpolated towards isn't there yet
+                zAges[i] = std::max(0.0f, currentTime - latest.zStartTime[i]);
+                zInstances[i * 3] = latest.zX[i];
+            }
+            zRise.sample(zAges.data(), zCount, &zInstances[1], 3);
+            zAlpha.sample(zAges.data(), zCount, &zInstances[2], 3);
+            for (size_t i = 0; i < zCount; ++i) {
+                zInstances[i * 3 + 1] += latest.zY[i];
+            }
+        }
 
-        glUseProgram(textShader);
-        glm::mat4 projection = glm::ortho(0.0f, static_cast<float>(SCR_WIDTH), 0.0f, static_cast<float>(SCR_HEIGHT));
-        glUniformMatrix4fv(glGetUniformLocation(textShader, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-        RenderTopRightText(textShader, infoText, 50.0f, 1.0f, glm::vec3(1.0f, 1.0f, 1.0f));
+        lights.clear();
+        if (latest.lightEnabled) {
+            if (latest.selectedRoom >= 0) {
+                // glows the colour window.frag pulses the lit window with
+                float pulse = lightPulse.sample(frame.time);
+                PointLight window = { windowCenters[latest.selectedRoom][0], windowCenters[latest.selectedRoom][1], 0.3f,
+                                      { 0.5f, 0.5f - 0.25f * pulse, 0.0f } };
+                lights.push_back(window);
+            }
+            for (int i = 0; i < fireflyCount; ++i) {
+                const float* firefly = &fireflies[i * 5];
+                float drift = currentTime * firefly[3] + firefly[2];
+                float flicker = 0.5f + 0.5f * sin(currentTime * 3.0f + firefly[4]);
+                PointLight light = { firefly[0] + 0.05f * sin(drift), firefly[1] + 0.03f * sin(drift * 1.7f), 0.05f,
+                                     { 0.6f * flicker, 0.8f * flicker, 0.2f * flicker } };
+                lights.push_back(light);
+            }
+        }
+        lightGrid->resize(framebufferWidth, framebufferHeight);
+        lightGrid->update(lights);
+
+        // Damage: everything that moves or animates, where it is drawn this
+        // frame; the tracker adds where it was drawn last frame.
+        damage.resize(framebufferWidth, framebufferHeight);
+        retained->resize(framebufferWidth, framebufferHeight);
+        PixelRect layersChanged;
+        layers->composite(layersChanged);
+        damage.addPixels(layersChanged);
+
+        shadowLights.clear();
+        shadowKey.clear();
+        if (shadows) {
+            // reach 0: the sun and moon reach across the whole window
+            ShadowLight sky = latest.isDay ? ShadowLight{ frame.sunX, frame.sunY, 0.0f, 0.4f }
+                                           : ShadowLight{ frame.moonX, frame.moonY, 0.0f, 0.2f };
+            shadowLights.push_back(sky);
+            if (latest.lightEnabled && latest.selectedRoom >= 0) {
+                ShadowLight lamp = { windowCenters[latest.selectedRoom][0], windowCenters[latest.selectedRoom][1], 1.2f, 0.35f };
+                shadowLights.push_back(lamp);
+            }
+            shadowKey.push_back((float)framebufferWidth);
+            shadowKey.push_back((float)framebufferHeight);
+            for (size_t i = 0; i < shadowLights.size(); ++i) {
+                shadowKey.push_back(shadowLights[i].x);
+                shadowKey.push_back(shadowLights[i].y);
+                shadowKey.push_back(shadowLights[i].radius);
+            }
+            for (size_t i = 0; i < latest.dogX.size(); ++i) {
+                shadowKey.push_back(lerp(latest.dogPrevX[i], latest.dogX[i], alpha));
+                shadowKey.push_back(lerp(latest.dogPrevY[i], latest.dogY[i], alpha));
+                shadowKey.push_back((float)latest.dogSprite[i]);
+            }
+            if (gpuAgents) {
+                shadowKey.push_back(gpuTime);
+            }
+        }
+        if (shadowKey != lastShadowKey) {
+            if (shadows) {
+                shadows->resize(framebufferWidth, framebufferHeight);
+                shadows->beginOccluders();
+                layers->drawLayer(LAYER_SCENERY);
+                drawDogs(latest, alpha);
+                shadows->endOccluders();
+                shadows->build(shadowLights);
+            }
+            // new shadows (or old ones gone) anywhere on the ground
+            damage.add(-1.0f, -1.0f, 1.0f, 0.0f);
+            lastShadowKey.swap(shadowKey);
+        }
+        // the heatmap counts in the stencil the damage mask would use, and has
+        // to be painted over everywhere once it goes away
+        if (fullRedraw || heatmapFrame || heatmapShown) {
+            damage.damageAll();
+        }
+        damage.add(frame.sunX - 0.1f, frame.sunY - 0.1f, frame.sunX + 0.1f, frame.sunY + 0.1f);
+        if (!latest.birdX.empty()) {
+            float birdMin[2] = { 1.0f, 1.0f };
+            float birdMax[2] = { -1.0f, -1.0f };
+            for (size_t i = 0; i < latest.birdX.size(); ++i) {
+                birdMin[0] = std::min(birdMin[0], std::min(latest.birdPrevX[i], latest.birdX[i]));
+                birdMin[1] = std::min(birdMin[1], std::min(latest.birdPrevY[i], latest.birdY[i]));
+                birdMax[0] = std::max(birdMax[0], std::max(latest.birdPrevX[i], latest.birdX[i]));
+                birdMax[1] = std::max(birdMax[1], std::max(latest.birdPrevY[i], latest.birdY[i]));
+            }
+            // a quad of half-size uSize, turned to face its heading
+            float birdReach = 0.008f * 1.5f;
+            damage.add(birdMin[0] - birdReach, birdMin[1] - birdReach, birdMax[0] + birdReach, birdMax[1] + birdReach);
+        }
+        for (size_t i = 0; i < latest.dogX.size(); ++i) {
+            const float* bounds = (latest.dogSprite[i] & SPRITE_FLIP) ? dogFlippedBounds : dogBounds;
+            float x = lerp(latest.dogPrevX[i], latest.dogX[i], alpha);
+            float y = lerp(latest.dogPrevY[i], latest.dogY[i], alpha);
+            damage.add(bounds[0] + x, bounds[1] + y, bounds[2] + x, bounds[3] + y);
+        }
+        if (gpuAgents) {
+            // they roam x offsets -0.1 to 1.3 over a lawn 0.1 deep (see agent_update.frag, dog.vert)
+            damage.add(std::min(dogBounds[0], dogFlippedBounds[0]) - 0.1f, dogBounds[1] - 0.1f,
+                       std::max(dogBounds[2], dogFlippedBounds[2]) + 1.3f, dogBounds[3]);
+        }
+        for (size_t i = 0; i < latest.smokeX.size(); ++i) {
+            // smoke.vert: wiggles up to 0.02 sideways, rises, then everything is scaled by 0.4
+            float x0 = (smokeBounds[0] - 0.02f + latest.smokeX[i]) * 0.4f;
+            float x1 = (smokeBounds[2] + 0.02f + latest.smokeX[i]) * 0.4f;
+            float y0 = (smokeBounds[1] + smokeRiseNow + 0.1f + latest.smokeY[i]) * 0.4f;
+            float y1 = (smokeBounds[3] + smokeRiseNow + 0.1f + latest.smokeY[i]) * 0.4f;
+            damage.add(x0, y0, x1, y1);
+        }
+        for (size_t i = 0; i < zCount; ++i) {
+            // z.vert wiggles the letter up to 0.01 sideways
+            float x = zInstances[i * 3];
+            float y = zInstances[i * 3 + 1];
+            damage.add(x + zBounds[0] - 0.01f, y + zBounds[1], x + zBounds[2] + 0.01f, y + zBounds[3]);
+        }
+        for (size_t i = 0; i < latest.foodX.size(); ++i) {
+            float y = lerp(latest.foodPrevY[i], latest.foodY[i], alpha);
+            damage.add(latest.foodX[i] + foodBounds[0], y + foodBounds[1], latest.foodX[i] + foodBounds[2], y + foodBounds[3]);
+        }
+        for (size_t i = 0; i < lights.size(); ++i) {
+            // the radius is in NDC heights
+            float reachX = lights[i].radius * framebufferHeight / std::max(framebufferWidth, 1);
+            damage.add(lights[i].x - reachX, lights[i].y - lights[i].radius, lights[i].x + reachX, lights[i].y + lights[i].radius);
+        }
+        damage.finish();
 
-        float dogTopY = dogY + (-0.55f); 
-        float dogCenter = getDogCenter(dogX, dogGoingLeft);
+        // Only the damaged pixels are drawn; the rest of the retained frame is still right.
+        retained->begin(damage);
+        if (heatmapFrame) {
+            heatmap->begin();
+        }
+        if (earlyZ) {
+            glClear(GL_DEPTH_BUFFER_BIT);
+            glEnable(GL_DEPTH_TEST);
+            // a pass covers its own earlier draws, like it would without depth
+            glDepthFunc(GL_LEQUAL);
+            glDisable(GL_BLEND);
+        }
 
-        glUseProgram(zShader);
-        glUniform1f(uTimeLocZ, currentTime);
-        glUniform3f(uColorLocZ, 1.0f, 1.0f, 1.0f); 
+        const FramePass* order = earlyZ ? earlyZOrder : painterOrder;
+        for (int pass = 0; pass < framePassCount; ++pass) {
+            if (earlyZ && order[pass] == PASS_SHADOWS) {
+                // the blended passes are tested against the opaque ones but don't hide what's behind them
+                glEnable(GL_BLEND);
+                glDepthMask(GL_FALSE);
+            }
+            if (useOit && order[pass] == PASS_TEXT) {
+                oit->begin(retained->depthStencil());
+            }
+            if (fragments) {
+                fragments->beginPass(order[pass]);
+            }
 
-        auto it = zLetters.begin();
-        while (it != zLetters.end()) {
-            float elapsed = currentTime - it->startTime;
-            if (elapsed > 2.0f) { 
-                it = zLetters.erase(it);
+            switch (order[pass]) {
+            case PASS_BACKGROUND:
+                layers->draw();
+                break;
+
+            case PASS_SUN:
+                updateCircleVertices(sunVertices, frame.sunX, frame.sunY, 0.1f, sunColor);
+                glBindBuffer(GL_ARRAY_BUFFER, sunVBO);
+                glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(sunVertices), sunVertices);
+
+                glUseProgram(sunShader);
+                glUniform1f(glGetUniformLocation(sunShader, "time"), frame.time);
+                glBindVertexArray(sunVAO);
+                glDrawArrays(GL_TRIANGLE_FAN, 0, ELLIPSE_SEGMENTS + 2);
+                break;
+
+            case PASS_BIRDS:
+                if (!latest.birdX.empty()) {
+                    const std::vector<float>* birdArrays[4] = { &latest.birdPrevX, &latest.birdPrevY, &latest.birdX, &latest.birdY };
+                    for (int i = 0; i < 4; ++i) {
+                        glBindBuffer(GL_ARRAY_BUFFER, birdInstanceVBOs[i]);
+                        glBufferData(GL_ARRAY_BUFFER, birdArrays[i]->size() * sizeof(float), birdArrays[i]->data(), GL_STREAM_DRAW);
+                    }
+
+                    glUseProgram(birdShader);
+                    glUniform1f(uAlphaLocBird, alpha);
+                    glUniform1f(uSizeLocBird, 0.008f);
+                    glUniform1f(uDimLocBird, latest.isDay ? 1.0f : 0.4f);
+                    glBindVertexArray(birdVAO);
+                    glDrawArraysInstanced(GL_TRIANGLES, 0, 6, (GLsizei)latest.birdX.size());
+                    glBindVertexArray(0);
+                }
+                break;
+
+            case PASS_DOGS:
+                drawDogs(latest, alpha);
+                break;
+
+            case PASS_SMOKE:
+                glUseProgram(smokeShader);
+                glUniform1f(uTimeLocSmoke, currentTime);
+                glUniform1f(uRiseLocSmoke, smokeRise.sample(currentTime));
+                glBindVertexArray(smokeVAO);
+                for (size_t i = 0; i < latest.smokeX.size(); ++i) {
+                    glUniform2f(uOriginLocSmoke, latest.smokeX[i], latest.smokeY[i]);
+                    glDrawArrays(GL_TRIANGLES, 0, 6);
+                }
+                glBindVertexArray(0);
+                break;
+
+            case PASS_SHADOWS:
+                if (shadows && !shadowLights.empty()) {
+                    // the sky doesn't take shadows
+                    shadows->apply(0.0f);
+                }
+                break;
+
+            case PASS_LIGHTS:
+                if (!lightGrid->empty()) {
+                    lightGrid->draw();
+                }
+                break;
+
+            case PASS_TEXT: {
+                glUseProgram(textShader);
+                glm::mat4 projection = glm::ortho(0.0f, static_cast<float>(SCR_WIDTH), 0.0f, static_cast<float>(SCR_HEIGHT));
+                glUniformMatrix4fv(glGetUniformLocation(textShader, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+                RenderTopRightText(textShader, infoText, 50.0f, 1.0f, glm::vec3(1.0f, 1.0f, 1.0f));
+                break;
             }
-            else {
-                glUniform1f(uStartTimeLocZ, it->startTime);
-                glUniform2f(uOriginLocZ, dogCenter - it->xOffset, dogTopY + 0.05);
 
+            case PASS_Z:
+                glUseProgram(zShader);
+                glUniform1f(uTimeLocZ, currentTime);
+                glUniform3f(uColorLocZ, 1.0f, 1.0f, 1.0f); 
                 glActiveTexture(GL_TEXTURE0);
                 glBindTexture(GL_TEXTURE_2D, Characters['Z'].TextureID);
-                glUniform1i(glGetUniformLocation(zShader, "uTexture"), 0);
-
-                glBindVertexArray(zVAO);
-                glDrawArrays(GL_TRIANGLES, 0, 6);
-                glBindVertexArray(0);
+                glUniform1i(uTextureLocZ, 0);
+                if (zCount > 0) {
+                    glBindBuffer(GL_ARRAY_BUFFER, zInstanceVBO);
+                    glBufferData(GL_ARRAY_BUFFER, zInstances.size() * sizeof(float), zInstances.data(), GL_STREAM_DRAW);
+                    glBindVertexArray(zVAO);
+                    glDrawArraysInstanced(GL_TRIANGLES, 0, 6, (GLsizei)zCount);
+                    glBindVertexArray(0);
+                }
+                break;
+
+            case PASS_FOOD:
+                if (!latest.foodX.empty()) {
+                    glUseProgram(foodShader);
+
+                    glm::mat4 foodView = glm::mat4(1.0f);
+                    glm::mat4 foodProjection = glm::mat4(1.0f);
+                    glUniformMatrix4fv(glGetUniformLocation(foodShader, "view"), 1, GL_FALSE, glm::value_ptr(foodView));
+                    glUniformMatrix4fv(glGetUniformLocation(foodShader, "projection"), 1, GL_FALSE, glm::value_ptr(foodProjection));
+
+                    size_t foodCount = latest.foodX.size();
+                    foodInstances.resize(foodCount * 2);
+                    for (size_t i = 0; i < foodCount; ++i) {
+                        foodInstances[i * 2] = latest.foodX[i];
+                        foodInstances[i * 2 + 1] = lerp(latest.foodPrevY[i], latest.foodY[i], alpha);
+                    }
+                    glBindBuffer(GL_ARRAY_BUFFER, foodInstanceVBO);
+                    glBufferData(GL_ARRAY_BUFFER, foodInstances.size() * sizeof(float), foodInstances.data(), GL_STREAM_DRAW);
+                    glBindVertexArray(foodVAO);
+                    glDrawArraysInstanced(GL_TRIANGLES, 0, 6, (GLsizei)foodCount);
+                    glBindVertexArray(0);
+                }
+                break;
+
+            default:
+                break;
+            }
 
-                ++it;
+            if (fragments) {
+                fragments->endPass();
             }
         }
+        if (useOit) {
+            oit->resolve();
+        }
+        if (earlyZ) {
+            glDepthMask(GL_TRUE);
+            glDisable(GL_DEPTH_TEST);
+        }
+        if (fragments) {
+            fragments->endFrame();
+        }
 
-        if (food.active) {
-            glUseProgram(foodShader);
-
-            glm::mat4 model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(food.x, food.y, 0.0f));
-
-            glm::mat4 foodView = glm::mat4(1.0f);
-            glm::mat4 foodProjection = glm::mat4(1.0f);
-
-            glUniformMatrix4fv(glGetUniformLocation(foodShader, "model"), 1, GL_FALSE, glm::value_ptr(model));
-            glUniformMatrix4fv(glGetUniformLocation(foodShader, "view"), 1, GL_FALSE, glm::value_ptr(foodView));
-            glUniformMatrix4fv(glGetUniformLocation(foodShader, "projection"), 1, GL_FALSE, glm::value_ptr(foodProjection));
-
-            glBindVertexArray(foodVAO);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
-            glBindVertexArray(0);
+        if (heatmapFrame) {
+            heatmap->end();
+            // what each pass shaded, from the occlusion queries
+            glUseProgram(textShader);
+            glUniform1i(glGetUniformLocation(textShader, "uOit"), GL_FALSE);
+            float lineY = SCR_HEIGHT - 30.0f;
+            for (int pass = 0; fragments && pass < PASS_COUNT; ++pass) {
+                if (fragments->average(pass) > 0.0) {
+                    std::ostringstream line;
+                    line << passNames[pass] << " " << (long long)fragments->average(pass);
+                    RenderText(textShader, line.str(), 10.0f, lineY, 0.8f, glm::vec3(1.0f, 1.0f, 1.0f));
+                    lineY -= 20.0f;
+                }
+            }
+            glUseProgram(textShader);
+            glUniform1i(glGetUniformLocation(textShader, "uOit"), useOit);
+        }
+        heatmapShown = heatmapFrame;
+        ++framesDrawn;
+        if (heatmapImagePath && framesDrawn == frameLimit
+            && saveFramebufferImage(heatmapImagePath, framebufferWidth, framebufferHeight)) {
+            std::cout << "Wrote the overdraw heatmap to " << heatmapImagePath << std::endl;
         }
 
+        retained->present();
+
+        pacer->frameBuilt();
         glfwSwapBuffers(window);
+        pacer->frameSubmitted();
+        if (frameLimit > 0 && framesDrawn >= frameLimit) {
+            glfwSetWindowShouldClose(window, true);
+        }
+        if (measureLatency) {
+            // wait for the swap to go through so "now" is close to when the frame hit the screen
+            glFinish();
+            if (latest.inputSerial != lastInputSerial) {
+                latency.add(simClockNow() - latest.inputTime);
+                lastInputSerial = latest.inputSerial;
+            }
+        }
         glfwPollEvents();
     }
 
+    stopSimulationThread();
+    if (measureLatency) {
+        latency.print("Input to present");
+    }
+    if (targetFps > 0.0) {
+        pacer->frameTimes().print("Frame time");
+    }
+    if (!fullRedraw) {
+        std::cout << "Redrawn per frame: " << damage.averageFraction() * 100.0 << "% of the window" << std::endl;
+    }
+    if (fragments) {
+        fragments->print(earlyZ ? "Fragments shaded" : "Fragments shaded (no early-Z)", passNames);
+        if (!lights.empty()) {
+            std::cout << "Lights evaluated per lit tile: " << lightGrid->averageTileLights() << " of " << lights.size()
+                << ", " << lightGrid->droppedTileLights() << " left out over the per-tile cap" << std::endl;
+        }
+    }
+    delete fragments;
+    delete pacer;
+    delete layers;
+    delete retained;
+    delete heatmap;
+    delete oit;
+    delete lightGrid;
+    delete shadows;
+    if (recordPath && saveInputLog(inputLog, recordPath)) {
+        std::cout << "Recorded " << inputLog.events.size() << " input events over " << inputLog.tickCount
+            << " steps to " << recordPath << std::endl;
+    }
+    delete gpuAgents;
+    if (agentUpdateShader) {
+        glDeleteProgram(agentUpdateShader);
+    }
+
     glDeleteVertexArrays(1, &rectangleVAO);
     glDeleteBuffers(1, &rectangleVBO);
 
@@ -1477,6 +2223,7 @@ int main() {
 
     glDeleteVertexArrays(1, &dogVAO);
     glDeleteBuffers(1, &dogVBO);
+    glDeleteBuffers(1, &dogInstanceVBO);
 
     glDeleteVertexArrays(1, &treebaseVAO);
     glDeleteBuffers(1, &treebaseVBO);
@@ -1492,6 +2239,15 @@ int main() {
 
     glDeleteVertexArrays(1, &foodVAO);
     glDeleteBuffers(1, &foodVBO);
+    glDeleteBuffers(1, &foodInstanceVBO);
+
+    glDeleteVertexArrays(1, &zVAO);
+    glDeleteBuffers(1, &zVBO);
+    glDeleteBuffers(1, &zInstanceVBO);
+
+    glDeleteVertexArrays(1, &birdVAO);
+    glDeleteBuffers(1, &birdVBO);
+    glDeleteBuffers(4, birdInstanceVBOs);
 
     glDeleteVertexArrays(1, &sunVAO);
     glDeleteBuffers(1, &sunVBO);
@@ -1507,6 +2263,14 @@ int main() {
     glDeleteProgram(windowShader);
     glDeleteProgram(smokeShader);
     glDeleteProgram(foodShader);
+    glDeleteProgram(birdShader);
+    glDeleteProgram(layerShader);
+    glDeleteProgram(damageMaskShader);
+    glDeleteProgram(heatmapShader);
+    glDeleteProgram(oitResolveShader);
+    glDeleteProgram(lightShader);
+    glDeleteProgram(shadowMapShader);
+    glDeleteProgram(shadowApplyShader);
 
     glfwDestroyCursor(cursor);
     glfwDestroyWindow(window);
@@ -1514,13 +2278,19 @@ int main() {
     return 0;
 }
 
-unsigned int createShaderProgram(const char* vertexShaderPath, const char* fragmentShaderPath) {
+// sharedFragmentPath, if given, is one more fragment shader linked in, for
+// functions several programs share
+unsigned int createShaderProgram(const char* vertexShaderPath, const char* fragmentShaderPath, const char* sharedFragmentPath) {
     unsigned int vertexShader = compileShader(GL_VERTEX_SHADER, vertexShaderPath);
     unsigned int fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentShaderPath);
+    unsigned int sharedShader = sharedFragmentPath ? compileShader(GL_FRAGMENT_SHADER, sharedFragmentPath) : 0;
     unsigned int program = glCreateProgram();
 
     glAttachShader(program, vertexShader);
     glAttachShader(program, fragmentShader);
+    if (sharedShader) {
+        glAttachShader(program, sharedShader);
+    }
     glLinkProgram(program);
     glValidateProgram(program);
 
@@ -1534,6 +2304,9 @@ unsigned int createShaderProgram(const char* vertexShaderPath, const char* fragm
 
     glDeleteShader(vertexShader);
     glDeleteShader(fragmentShader);
+    if (sharedShader) {
+        glDeleteShader(sharedShader);
+    }
 
     return program;
 }
@@ -1579,60 +2352,54 @@ unsigned int compileShader(GLenum type, const char* source)
     return shader;
 }
 
-void processInput(GLFWwindow* window) {
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
-        glfwSetWindowShouldClose(window, true);
+static unsigned int inputKeyFor(int key) {
+    switch (key) {
+    case GLFW_KEY_A: return INPUT_MOVE_LEFT;
+    case GLFW_KEY_D: return INPUT_MOVE_RIGHT;
+    case GLFW_KEY_W: return INPUT_PAINT_UP;
+    case GLFW_KEY_S: return INPUT_PAINT_DOWN;
+    case GLFW_KEY_N: return INPUT_TOGGLE_NIGHT;
+    case GLFW_KEY_B: return INPUT_SHOW_CHARACTER;
+    case GLFW_KEY_V: return INPUT_HIDE_CHARACTER;
+    default: return 0;
     }
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
-        paintProgress += 0.01f;
-        paintProgress = clip(paintProgress, 0.0f, 1.0f);
-    }
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
-        paintProgress -= 0.01f;
-        paintProgress = clip(paintProgress, 0.0f, 1.0f);
-    }
-    if (glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS && !keyPressed) {
-        keyPressed = true;
-        transitionInProgress = true;
-        transparencyEnabled = true;
-        lightEnabled = !lightEnabled;
-        selectedRoom = rand() % 7;
-        transitionStartTime = glfwGetTime();
-        cout << "Toggled day/night: " << (isDay ? "Day" : "Night") << endl;
+}
+
+void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
+        glfwSetWindowShouldClose(window, true);
     }
-    if (glfwGetKey(window, GLFW_KEY_N) == GLFW_RELEASE) {
-        keyPressed = false;
+    // a debug view, not input: the simulation (and a recording) never sees it
+    if (key == GLFW_KEY_H && action == GLFW_PRESS) {
+        showHeatmap = !showHeatmap;
+        windowDirty = true;
     }
-    if (isDay) {
-        if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
-            dogX -= dogSpeed;
-            dogX = clip(dogX, dogMinX, dogMaxX);
-            dogGoingLeft = true;
 
-        }
-        if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
-            dogX += dogSpeed;
-            dogX = clip(dogX, dogMinX, dogMaxX);
-            dogGoingLeft = false;
-        }
+    unsigned int bit = inputKeyFor(key);
+    unsigned int keys = heldKeys;
+    if (action == GLFW_PRESS) keys |= bit;
+    if (action == GLFW_RELEASE) keys &= ~bit;
+    if (keys != heldKeys) {
+        heldKeys = keys;
+        queueHeldKeys(keys, simClockNow());
     }
+}
 
-    if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS) {
-        transparencyEnabled = true;
-        selectedRoom = rand() % 7;
-    }
-    if (glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS) {
-        transparencyEnabled = false;
-        selectedRoom = -1;
-    }
+void cursorPosCallback(GLFWwindow* window, double x, double y) {
+    cursorX = x;
+    cursorY = y;
+}
 
-    if (glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS) {
-        transparencyEnabled = false;
-    }
+void windowSizeCallback(GLFWwindow* window, int width, int height) {
+    windowWidth = width;
+    windowHeight = height;
 }
 
 void framebufferSizeCallback(GLFWwindow* window, int width, int height) {
     glViewport(0, 0, width, height);
+    framebufferWidth = width;
+    framebufferHeight = height;
+    windowDirty = true;
 }
 
 
@@ -1655,40 +2422,6 @@ void updateTreeBaseColors(float* treeBase, unsigned int VBO, float paintProgress
     glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(float) * 6 * 6, treeBase);
 }
 
-void calculateSunMoonPosition(float progress, float& sunX, float& sunY, float& moonX, float& moonY) {
-    float sunStartX, sunStartY, sunEndX, sunEndY;
-    float moonStartX, moonStartY, moonEndX, moonEndY;
-    if (isDay) {
-        sunStartX = -0.8f;
-        sunStartY = 0.8f;
-        sunEndX = 1.2f;
-        sunEndY = 0.6f;
-
-        moonStartX = -1.2f;
-        moonStartY = 0.6f;
-        moonEndX = -0.8f;
-        moonEndY = 0.8f;
-    }
-    else {
-        moonStartX = -0.8f;
-        moonStartY = 0.8f;
-        moonEndX = 1.2f;
-        moonEndY = 0.6f;
-
-        sunStartX = -1.2f;
-        sunStartY = 0.6f;
-        sunEndX = -0.8f;
-        sunEndY = 0.8f;
-    }
-
-    sunX = sunStartX + (sunEndX - sunStartX) * progress;
-    sunY = sunStartY + (sunEndY - sunStartY) * progress;
-
-    moonX = moonStartX + (moonEndX - moonStartX) * progress;
-    moonY = moonStartY + (moonEndY - moonStartY) * progress;
-}
-
-
 void updateCircleVertices(float* vertices, float centerX, float centerY, float radius, float* color) {
     vertices[0] = centerX;
     vertices[1] = centerY;
@@ -1754,9 +2487,6 @@ void RenderText(unsigned int shader, std::string text, float x, float y, float s
 }
 
 
-float clip(float n, float lower, float upper) {
-    return std::max(lower, std::min(n, upper));
-}
 float CalculateTextWidth(const std::string& text, float scale) {
     float width = 0.0f;
     for (const char& c : text) {
@@ -1779,14 +2509,62 @@ void RenderTopRightText(unsigned int textShader, const std::string& text, float
     RenderText(textShader, text, x, y, scale, color);
 }
 
-static unsigned loadImageToTexture(const char* filePath) {
-    int TextureWidth;
-    int TextureHeight;
-    int TextureChannels;
+static void meshBounds(const float* vertices, int vertexCount, int stride, float* bounds) {
+    bounds[0] = bounds[2] = vertices[0];
+    bounds[1] = bounds[3] = vertices[1];
+    for (int i = 1; i < vertexCount; ++i) {
+        const float* v = vertices + i * stride;
+        bounds[0] = std::min(bounds[0], v[0]);
+        bounds[1] = std::min(bounds[1], v[1]);
+        bounds[2] = std::max(bounds[2], v[0]);
+        bounds[3] = std::max(bounds[3], v[1]);
+    }
+}
+
+// NDC depth of the index-th of count things drawn back to front; later is nearer.
+static float painterDepth(int index, int count) {
+    return 1.0f - 2.0f * (index + 1) / (count + 1);
+}
+
+// Draws a layer's meshes. With early-Z they go front to back with a depth
+// test, so where the house covers the fence or the moon the sky, the pixel is
+// only shaded once; the depth each mesh gets keeps the painter order.
+static void drawLayerMeshes(const LayerMesh* meshes, int count, int uDepthLoc, int isFenceLoc) {
+    if (earlyZ) {
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_LESS);
+        // they're all opaque
+        glDisable(GL_BLEND);
+    }
+    for (int i = 0; i < count; ++i) {
+        int index = earlyZ ? count - 1 - i : i;
+        const LayerMesh& mesh = meshes[index];
+        glUniform1f(uDepthLoc, painterDepth(index, count));
+        glUniform1f(isFenceLoc, mesh.fence ? GL_TRUE : GL_FALSE);
+        glBindVertexArray(mesh.VAO);
+        glDrawArrays(mesh.mode, 0, mesh.vertexCount);
+    }
+    glBindVertexArray(0);
+    if (earlyZ) {
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_BLEND);
+    }
+}
+
+static void decodeImage(const char* filePath, bool flip, int channels, DecodedImage& image) {
+    stbi_set_flip_vertically_on_load_thread(flip);
+    image.pixels = stbi_load(filePath, &image.width, &image.height, &image.channels, channels);
+    if (channels != 0) {
+        image.channels = channels;
+    }
+}
 
-    stbi_set_flip_vertically_on_load(true);
+static unsigned uploadImageToTexture(const DecodedImage& image, const char* filePath) {
+    int TextureWidth = image.width;
+    int TextureHeight = image.height;
+    int TextureChannels = image.channels;
+    unsigned char* ImageData = image.pixels;
 
-    unsigned char* ImageData = stbi_load(filePath, &TextureWidth, &TextureHeight, &TextureChannels, 0);
     if (ImageData != NULL) {
         GLint format = -1;
         switch (TextureChannels) {
@@ -1820,101 +2598,13 @@ static unsigned loadImageToTexture(const char* filePath) {
 }
 
 
-float getDogCenter(float dogX, bool dogGoingLeft) {
-    float localX = -0.56;
-    float center;
-
-    if (dogGoingLeft) center = 2.0f * dogCenterX - localX;
-    else center = localX; 
-
-    return dogX + center;
-}
-
 void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
-    if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
-        double xpos, ypos;
-        glfwGetCursorPos(window, &xpos, &ypos);
-
-        int width, height;
-        glfwGetWindowSize(window, &width, &height);
+    if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS && windowWidth > 0 && windowHeight > 0) {
+        float xNDC = (float)(cursorX / windowWidth) * 2.0f - 1.0f;
+        float yNDC = 1.0f - (float)(cursorY / windowHeight) * 2.0f;
 
-        float xNDC = (float)(xpos / width) * 2.0f - 1.0f;
-        float yNDC = 1.0f - (float)(ypos / height) * 2.0f;
-
-        if (isClickOnGrass(xNDC, yNDC)) {
-            spawnFood(xNDC, yNDC);
+        if (isClickAboveGround(yNDC)) {
+            queueFoodSpawn(xNDC, yNDC, simClockNow());
         }
     }
 }
-
-bool isClickOnGrass(float x, float y) {
-    float grassBottom = -0.8f;
-    float grassTop = -0.55f;
-
-    if (y >= grassBottom && y <= grassTop) {
-        return true;
-    }
-    return false;
-}
-
-
-void spawnFood(float xFood, float y) {
-    if (!food.active) {
-        food.x = xFood;
-        food.y = -0.7f;
-        food.active = true;
-        cout << "Food spawned at x :" << food.x << " , y:" << food.y << endl;
-    } 
-}
-
-void animateDog() {
-    const float epsilon = 0.001f; 
-
-    switch (dogState) {
-    case DOG_IDLE:
-        if (isDay && food.active) {
-            dogPreviousX = getDogCenter(dogX, dogGoingLeft);
-            dogStartingX = dogPreviousX;
-            dogState = DOG_MOVING_TO_FOOD;
-        }
-        break;
-
-    case DOG_MOVING_TO_FOOD: {
-        float dx = food.x - getDogCenter(dogX, dogGoingLeft);
-        float speed = 0.002f; 
-
-        if (fabs(dx) > epsilon) {
-            dogX += (dx / fabs(dx)) * speed; 
-            dogGoingLeft = (dx < 0); 
-        }
-        else {
-            dogX = food.x - getDogCenter(0.0f, dogGoingLeft); 
-            dogState = DOG_EATING;
-            eatingStartTime = glfwGetTime();
-            eatingDuration = 3.0f + static_cast<float>(rand() % 200) / 100.0f; 
-        }
-    } break;
-
-    case DOG_EATING:
-        if (glfwGetTime() - eatingStartTime >= eatingDuration) {
-            dogState = DOG_RETURNING; 
-            food.active = false; 
-        }
-        break;
-
-    case DOG_RETURNING: {
-        float dx = dogStartingX - getDogCenter(dogX, dogGoingLeft);
-        float speed = 0.002f; 
-
-        if (fabs(dx) > epsilon) {
-            dogX += (dx / fabs(dx)) * speed; 
-            dogGoingLeft = (dx < 0); 
-        }
-        else {
-            dogX = dogStartingX - getDogCenter(0.0f, dogGoingLeft); 
-            dogState = DOG_IDLE; 
-        }
-    } break;
-    }
-}
-
@@ -0,0 +1,101 @@
+#include "oit.h"
+
+#include <GL/glew.h>
+#include <iostream>
+
+using namespace std;
+
+WeightedOit::WeightedOit(unsigned int resolveShader)
+    : accumTexture(0), weightTexture(0), framebuffer(0), attachedDepth(0), previousFramebuffer(0),
+      resolveShader(resolveShader), width(0), height(0) {
+    // the resolve builds its fullscreen triangle from gl_VertexID
+    glGenVertexArrays(1, &emptyVAO);
+    uAccumLoc = glGetUniformLocation(resolveShader, "uAccum");
+    uWeightLoc = glGetUniformLocation(resolveShader, "uWeight");
+}
+
+WeightedOit::~WeightedOit() {
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteTextures(1, &accumTexture);
+    glDeleteTextures(1, &weightTexture);
+    glDeleteVertexArrays(1, &emptyVAO);
+}
+
+static void allocateTarget(unsigned int texture, GLint format, GLenum channels, int width, int height) {
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, channels, GL_HALF_FLOAT, nullptr);
+}
+
+void WeightedOit::resize(int width, int height) {
+    if (width == this->width && height == this->height) {
+        return;
+    }
+    this->width = width;
+    this->height = height;
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+
+    if (!framebuffer) {
+        glGenTextures(1, &accumTexture);
+        glGenTextures(1, &weightTexture);
+        glGenFramebuffers(1, &framebuffer);
+    }
+    // half floats: the weighted sums run far past 1
+    allocateTarget(accumTexture, GL_RGBA16F, GL_RGBA, width, height);
+    allocateTarget(weightTexture, GL_R16F, GL_RED, width, height);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    GLint previous = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, accumTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, weightTexture, 0);
+    const GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, drawBuffers);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        cerr << "OIT framebuffer is incomplete" << endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, previous);
+}
+
+void WeightedOit::begin(unsigned int depthStencil) {
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    if (depthStencil != attachedDepth) {
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthStencil);
+        attachedDepth = depthStencil;
+    }
+
+    // nothing accumulated, everything revealed
+    const float accumClear[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    const float weightClear[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    glClearBufferfv(GL_COLOR, 0, accumClear);
+    glClearBufferfv(GL_COLOR, 1, weightClear);
+
+    // GL 3.3 has one blend function for all targets: rgb adds in both, the
+    // accumulation target's alpha multiplies by 1 - alpha
+    glEnable(GL_BLEND);
+    glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void WeightedOit::resolve() {
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+    glDisable(GL_DEPTH_TEST);
+    glUseProgram(resolveShader);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, accumTexture);
+    glUniform1i(uAccumLoc, 0);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, weightTexture);
+    glUniform1i(uWeightLoc, 1);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glBindVertexArray(emptyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glActiveTexture(GL_TEXTURE0);
+    glUseProgram(0);
+}
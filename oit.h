@@ -0,0 +1,44 @@
+#pragma once
+
+// Weighted blended order-independent transparency (McGuire and Bavoil).
+// Translucent draws go into two targets instead of straight over the frame:
+// an accumulation target that sums colour times alpha times a weight (rgb)
+// and multiplies up how much of the background still shows through (alpha,
+// the revealage), and a second one that sums alpha times the weight. One
+// resolve pass then lays the weighted average colour over the frame with the
+// combined coverage. Sums and products don't care about order, so
+// translucent geometry can be drawn unsorted and in batches; the weight
+// favours nearer fragments so the result stays close to sorted blending.
+// Translucent fragment shaders write the targets when their uOit is set.
+class WeightedOit {
+public:
+    // resolveShader is the oit_resolve program; needs a current GL context
+    explicit WeightedOit(unsigned int resolveShader);
+    ~WeightedOit();
+    WeightedOit(const WeightedOit&) = delete;
+    WeightedOit& operator=(const WeightedOit&) = delete;
+
+    // Same size as the framebuffers it resolves into.
+    void resize(int width, int height);
+    // Sends the draws that follow into the targets, cleared within the
+    // scissor. depthStencil (a depth-stencil renderbuffer, 0 for none) is
+    // what they're tested against; leave depth writes off. Remembers the
+    // framebuffer that was bound.
+    void begin(unsigned int depthStencil);
+    // Rebinds that framebuffer and blends the translucent layer over it, as
+    // premultiplied alpha. Leaves the depth test off.
+    void resolve();
+
+private:
+    unsigned int accumTexture;
+    unsigned int weightTexture;
+    unsigned int framebuffer;
+    unsigned int attachedDepth;
+    int previousFramebuffer;
+    unsigned int resolveShader;
+    int uAccumLoc;
+    int uWeightLoc;
+    unsigned int emptyVAO;
+    int width;
+    int height;
+};
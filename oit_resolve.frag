@@ -0,0 +1,18 @@
+#version 330 core
+
+out vec4 FragColor;
+
+uniform sampler2D uAccum;  // rgb: sum of colour * alpha * weight, a: revealage
+uniform sampler2D uWeight; // r: sum of alpha * weight
+
+void main() {
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    vec4 accum = texelFetch(uAccum, texel, 0);
+    float revealage = accum.a;
+    // nothing translucent here
+    if (revealage >= 1.0) {
+        discard;
+    }
+    vec3 average = accum.rgb / max(texelFetch(uWeight, texel, 0).r, 1e-5);
+    FragColor = vec4(average * (1.0 - revealage), 1.0 - revealage);
+}
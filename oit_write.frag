@@ -0,0 +1,22 @@
+#version 330 core
+
+// Linked into every translucent program (createShaderProgram's third
+// argument), which calls writeColor instead of writing its output itself.
+// With uOit set, the fragment goes into the weighted OIT targets (see oit.h)
+// instead of being blended over the frame.
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out vec4 OitWeight;
+
+uniform bool uOit;
+
+void writeColor(vec4 color) {
+    if (uOit) {
+        // nearer and more opaque fragments count for more
+        float weight = clamp(pow(min(1.0, color.a * 10.0) + 0.01, 3.0) * 1e8 * pow(1.0 - gl_FragCoord.z * 0.9, 3.0), 1e-2, 3e3);
+        FragColor = vec4(color.rgb * color.a * weight, color.a);
+        OitWeight = vec4(color.a * weight);
+    }
+    else {
+        FragColor = color;
+    }
+}
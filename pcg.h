@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+
+// PCG32 (O'Neill's pcg32: 64-bit LCG state, xorshift + random rotation
+// output). Same seed, same sequence on every platform and standard library,
+// which std::minstd_rand with std distributions does not promise for floats.
+// Satisfies UniformRandomBitGenerator so the std distributions still work.
+class Pcg32 {
+public:
+    typedef uint32_t result_type;
+
+    explicit Pcg32(uint64_t seed = 0x853c49e6748fea9bull, uint64_t stream = 0xda3e39cb94b95bdbull)
+        : state(0), increment((stream << 1) | 1) {
+        (*this)();
+        state += seed;
+        (*this)();
+    }
+
+    static result_type min() { return 0; }
+    static result_type max() { return 0xFFFFFFFFu; }
+
+    result_type operator()() {
+        uint64_t old = state;
+        state = old * 6364136223846793005ull + increment;
+        uint32_t shifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+        uint32_t rotation = (uint32_t)(old >> 59);
+        return (shifted >> rotation) | (shifted << ((32 - rotation) & 31));
+    }
+
+    // Uniform in [0, bound) without modulo bias.
+    uint32_t below(uint32_t bound) {
+        uint32_t threshold = (0u - bound) % bound;
+        while (true) {
+            uint32_t r = (*this)();
+            if (r >= threshold) {
+                return r % bound;
+            }
+        }
+    }
+
+    // Uniform in [0, 1), from the top 24 bits so every value is exact in a float.
+    float unit() {
+        return ((*this)() >> 8) * (1.0f / 16777216.0f);
+    }
+
+private:
+    uint64_t state;
+    uint64_t increment;
+};
@@ -0,0 +1,177 @@
+#include "physics.h"
+#include "job_system.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+// pairs per job when a contact batch is solved in parallel
+const size_t contactsPerJob = 1024;
+// a body can be in at most this many batches before its pairs spill into a final serial batch
+const size_t maxContactBatches = 32;
+
+const vector<BodyPair>& SweepAndPrune::findPairs(const vector<float>& minX, const vector<float>& maxX,
+                                                 const vector<float>& minY, const vector<float>& maxY,
+                                                 size_t maxCandidates) {
+    size_t count = minX.size();
+    if (order.size() != count) {
+        // bodies came or went: nothing to go on, so a full sort
+        order.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            order[i] = (unsigned int)i;
+        }
+        sort(order.begin(), order.end(), [&minX](unsigned int a, unsigned int b) { return minX[a] < minX[b]; });
+    }
+
+    // insertion sort on last step's order: close to linear for a scene that barely moved
+    for (size_t i = 1; i < count; ++i) {
+        unsigned int body = order[i];
+        float key = minX[body];
+        size_t j = i;
+        while (j > 0 && minX[order[j - 1]] > key) {
+            order[j] = order[j - 1];
+            --j;
+        }
+        order[j] = body;
+    }
+
+    sortedMinX.resize(count);
+    sortedMaxX.resize(count);
+    sortedMinY.resize(count);
+    sortedMaxY.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        unsigned int body = order[i];
+        sortedMinX[i] = minX[body];
+        sortedMaxX[i] = maxX[body];
+        sortedMinY[i] = minY[body];
+        sortedMaxY[i] = maxY[body];
+    }
+
+    // how many boxes after each one start before it ends: min x is sorted, so a binary search
+    runLengths.resize(count);
+    size_t candidates = 0;
+    unsigned int longestRun = 0;
+    for (size_t i = 0; i < count; ++i) {
+        size_t end = upper_bound(sortedMinX.begin() + i + 1, sortedMinX.end(), sortedMaxX[i]) - sortedMinX.begin();
+        runLengths[i] = (unsigned int)(end - i - 1);
+        candidates += runLengths[i];
+        longestRun = max(longestRun, runLengths[i]);
+    }
+
+    // over budget: the longest run length that keeps the total within it
+    unsigned int maxRun = longestRun;
+    size_t tested = candidates;
+    if (candidates > maxCandidates) {
+        unsigned int low = 0;
+        unsigned int high = longestRun;
+        tested = 0;
+        while (low < high) {
+            unsigned int run = low + (high - low + 1) / 2;
+            size_t total = 0;
+            for (size_t i = 0; i < count; ++i) {
+                total += min(runLengths[i], run);
+            }
+            if (total <= maxCandidates) {
+                low = run;
+                tested = total;
+            }
+            else {
+                high = run - 1;
+            }
+        }
+        maxRun = low;
+    }
+    skipped = candidates - tested;
+
+    pairs.clear();
+    overlapsY.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        float boxMinY = sortedMinY[i];
+        float boxMaxY = sortedMaxY[i];
+        size_t end = i + 1 + min(runLengths[i], maxRun);
+
+        // everything in (i, end) overlaps on x; test y for the whole run before branching
+        for (size_t j = i + 1; j < end; ++j) {
+            overlapsY[j] = (unsigned char)((sortedMinY[j] <= boxMaxY) & (sortedMaxY[j] >= boxMinY));
+        }
+        for (size_t j = i + 1; j < end; ++j) {
+            if (overlapsY[j]) {
+                BodyPair pair = { order[i], order[j] };
+                pairs.push_back(pair);
+            }
+        }
+    }
+    return pairs;
+}
+
+void buildContactBatches(const vector<BodyPair>& pairs, size_t bodyCount, vector<vector<BodyPair>>& batches) {
+    // bit k set = the body already has a pair in batch k
+    vector<unsigned int> usedBatches(bodyCount, 0);
+    for (size_t i = 0; i < batches.size(); ++i) {
+        batches[i].clear();
+    }
+    batches.resize(maxContactBatches + 1);
+
+    for (size_t i = 0; i < pairs.size(); ++i) {
+        unsigned int used = usedBatches[pairs[i].a] | usedBatches[pairs[i].b];
+        size_t batch = 0;
+        while (batch < maxContactBatches && (used & (1u << batch))) {
+            ++batch;
+        }
+        batches[batch].push_back(pairs[i]);
+        if (batch < maxContactBatches) {
+            usedBatches[pairs[i].a] |= 1u << batch;
+            usedBatches[pairs[i].b] |= 1u << batch;
+        }
+    }
+
+    while (!batches.empty() && batches.back().empty()) {
+        batches.pop_back();
+    }
+}
+
+static void separatePairs(const vector<BodyPair>& pairs, size_t begin, size_t end, float* x, float* y,
+                          const unsigned char* fixedX, float halfWidth, float halfHeight, float correction) {
+    for (size_t i = begin; i < end; ++i) {
+        unsigned int a = pairs[i].a;
+        unsigned int b = pairs[i].b;
+        float dx = x[b] - x[a];
+        float dy = y[b] - y[a];
+        float overlapX = 2.0f * halfWidth - fabs(dx);
+        float overlapY = 2.0f * halfHeight - fabs(dy);
+        if (overlapX <= 0.0f || overlapY <= 0.0f) {
+            continue;
+        }
+
+        // bodies at the same spot still need a direction: split by index
+        if (overlapX < overlapY && !fixedX[a] && !fixedX[b]) {
+            float push = 0.5f * correction * overlapX * (dx > 0.0f || (dx == 0.0f && b > a) ? 1.0f : -1.0f);
+            x[a] -= push;
+            x[b] += push;
+        }
+        else {
+            float push = 0.5f * correction * overlapY * (dy > 0.0f || (dy == 0.0f && b > a) ? 1.0f : -1.0f);
+            y[a] -= push;
+            y[b] += push;
+        }
+    }
+}
+
+void separateBodies(const vector<vector<BodyPair>>& batches, vector<float>& x, vector<float>& y,
+                    const vector<unsigned char>& fixedX, float halfWidth, float halfHeight, float correction,
+                    JobSystem* jobs) {
+    for (size_t b = 0; b < batches.size(); ++b) {
+        const vector<BodyPair>& batch = batches[b];
+        // the last batch holds overflow pairs that may share bodies: always serial
+        bool independent = b < maxContactBatches;
+        if (jobs && independent && batch.size() > contactsPerJob) {
+            jobs->parallelFor("contacts", batch.size(), contactsPerJob, [&](size_t begin, size_t end) {
+                separatePairs(batch, begin, end, x.data(), y.data(), fixedX.data(), halfWidth, halfHeight, correction);
+            });
+        }
+        else {
+            separatePairs(batch, 0, batch.size(), x.data(), y.data(), fixedX.data(), halfWidth, halfHeight, correction);
+        }
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+class JobSystem;
+
+struct BodyPair {
+    unsigned int a;
+    unsigned int b;
+};
+
+// Sort-and-sweep broadphase over axis-aligned boxes. Boxes are kept sorted by
+// min x between calls (insertion sort, cheap when bodies move a little per
+// step) and gathered into packed sorted arrays, so the sweep only walks
+// contiguous floats: the x run of each box, then a branch-free y test over it.
+class SweepAndPrune {
+public:
+    SweepAndPrune() : skipped(0) {}
+
+    // Overlapping pairs of boxes; body indices are positions in the input arrays.
+    // Exact as long as the boxes overlapping in x make at most maxCandidates
+    // pairs. Past that, every box's run is cut to the same length, its nearest
+    // neighbours in x order, so the sweep stays within maxCandidates; the
+    // candidates left untested are counted in skippedCandidates().
+    const std::vector<BodyPair>& findPairs(const std::vector<float>& minX, const std::vector<float>& maxX,
+                                           const std::vector<float>& minY, const std::vector<float>& maxY,
+                                           size_t maxCandidates);
+    // x-overlapping pairs the last findPairs didn't test for the budget
+    size_t skippedCandidates() const { return skipped; }
+
+private:
+    std::vector<unsigned int> order;
+    std::vector<float> sortedMinX;
+    std::vector<float> sortedMaxX;
+    std::vector<float> sortedMinY;
+    std::vector<float> sortedMaxY;
+    std::vector<unsigned int> runLengths;
+    std::vector<unsigned char> overlapsY;
+    std::vector<BodyPair> pairs;
+    size_t skipped;
+};
+
+// Splits pairs into batches in which no body appears twice, so every batch can
+// be solved in parallel without two jobs writing the same body.
+void buildContactBatches(const std::vector<BodyPair>& pairs, size_t bodyCount, std::vector<std::vector<BodyPair>>& batches);
+
+// Pushes overlapping boxes apart along their axis of least penetration, each
+// body by half of correction * overlap. Bodies flagged in fixedX are only ever
+// pushed along y, so a pair involving one always separates vertically.
+// Boxes are centered on (x, y) with the given half extents.
+void separateBodies(const std::vector<std::vector<BodyPair>>& batches, std::vector<float>& x, std::vector<float>& y,
+                    const std::vector<unsigned char>& fixedX, float halfWidth, float halfHeight, float correction,
+                    JobSystem* jobs);
@@ -0,0 +1,67 @@
+#version 330 core
+
+in vec2 TexCoord;
+// multiplied into the frame: 1 where every light gets through
+out vec4 FragColor;
+
+uniform sampler2D uOccluders;
+uniform sampler2D uShadowMap;
+uniform vec4 uLights[4];   // as in shadow_map.frag
+uniform int uLightCount;
+uniform float uAspect;
+
+const float PI = 3.14159265;
+// PCF taps along the angle. The penumbra widens with how far past its
+// blocker a pixel is (in map texels per unit of the light's reach), so
+// shadows are sharp where they touch their caster and soften away from it,
+// up to MAX_SPREAD texels either side, past which the taps would band.
+const int TAPS = 9;
+const float SEARCH = 6.0;
+const float SOFTNESS = 24.0;
+const float MAX_SPREAD = 6.0;
+
+void main() {
+    if (texture(uOccluders, TexCoord).a > 0.5) {
+        discard;
+    }
+
+    float texel = 1.0 / float(textureSize(uShadowMap, 0).x);
+    float rows = float(textureSize(uShadowMap, 0).y);
+    float shadow = 0.0;
+    for (int i = 0; i < uLightCount; ++i) {
+        vec4 light = uLights[i];
+        vec2 offset = (TexCoord - light.xy) * vec2(uAspect, 1.0) / light.z;
+        float distance = length(offset);
+        if (distance >= 1.0) {
+            continue;
+        }
+        float u = atan(offset.y, offset.x) / (2.0 * PI) + 0.5;
+        float v = (float(i) + 0.5) / rows;
+
+        // average distance of whatever blocks the pixel around its direction
+        float blockers = 0.0;
+        float blockerSum = 0.0;
+        for (int tap = -TAPS / 2; tap <= TAPS / 2; ++tap) {
+            float depth = texture(uShadowMap, vec2(u + float(tap) * SEARCH * texel / float(TAPS / 2), v)).r;
+            if (depth < distance) {
+                blockers += 1.0;
+                blockerSum += depth;
+            }
+        }
+        if (blockers == 0.0) {
+            continue;
+        }
+
+        float spread = min(0.5 + SOFTNESS * (distance - blockerSum / blockers), MAX_SPREAD) * texel / float(TAPS / 2);
+        float lit = 0.0;
+        for (int tap = -TAPS / 2; tap <= TAPS / 2; ++tap) {
+            lit += step(distance, texture(uShadowMap, vec2(u + float(tap) * spread, v)).r);
+        }
+        // fades out towards the edge of the light's reach
+        shadow += (1.0 - lit / float(TAPS)) * light.w * (1.0 - distance * distance);
+    }
+    if (shadow <= 0.0) {
+        discard;
+    }
+    FragColor = vec4(vec3(1.0 - min(shadow, 0.8)), 1.0);
+}
@@ -0,0 +1,14 @@
+#version 330 core
+
+// The part of the window below uGroundTop, as a strip of two triangles: the
+// sky never takes shadows, so it isn't shaded at all.
+out vec2 TexCoord;
+
+uniform float uGroundTop;  // NDC y
+uniform float uDepth;
+
+void main() {
+    vec2 position = vec2(gl_VertexID & 1, (gl_VertexID >> 1) * (uGroundTop + 1.0) * 0.5);
+    TexCoord = position;
+    gl_Position = vec4(position * 2.0 - 1.0, uDepth, 1.0);
+}
@@ -0,0 +1,182 @@
+#include "shadow_map.h"
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+using namespace std;
+
+// march steps per direction; half the directions keeps a step about as long
+// as the gap between neighbouring directions a third of the way out
+static int stepsFor(int resolution) {
+    return max(resolution / 2, 16);
+}
+
+ShadowMaps::ShadowMaps(unsigned int mapShader, unsigned int applyShader, int resolution, int maskDivisor)
+    : maskTexture(0), maskFramebuffer(0), mapTexture(0), mapFramebuffer(0), mapShader(mapShader),
+      applyShader(applyShader), resolution(resolution), maskDivisor(max(maskDivisor, 1)), width(0), height(0),
+      lightCount(0), previousFramebuffer(0) {
+    glGenVertexArrays(1, &emptyVAO);
+
+    // one row per light; the angle wraps around, the rows don't
+    glGenTextures(1, &mapTexture);
+    glBindTexture(GL_TEXTURE_2D, mapTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, resolution, maxLights, 0, GL_RED, GL_HALF_FLOAT, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glGenFramebuffers(1, &mapFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, mapFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mapTexture, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        cerr << "Shadow map framebuffer is incomplete" << endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    uMapOccludersLoc = glGetUniformLocation(mapShader, "uOccluders");
+    uMapLightsLoc = glGetUniformLocation(mapShader, "uLights");
+    uMapAspectLoc = glGetUniformLocation(mapShader, "uAspect");
+    uMapResolutionLoc = glGetUniformLocation(mapShader, "uResolution");
+    uMapStepsLoc = glGetUniformLocation(mapShader, "uSteps");
+    uApplyOccludersLoc = glGetUniformLocation(applyShader, "uOccluders");
+    uApplyShadowMapLoc = glGetUniformLocation(applyShader, "uShadowMap");
+    uApplyLightsLoc = glGetUniformLocation(applyShader, "uLights");
+    uApplyLightCountLoc = glGetUniformLocation(applyShader, "uLightCount");
+    uApplyAspectLoc = glGetUniformLocation(applyShader, "uAspect");
+    uApplyGroundTopLoc = glGetUniformLocation(applyShader, "uGroundTop");
+}
+
+ShadowMaps::~ShadowMaps() {
+    glDeleteFramebuffers(1, &maskFramebuffer);
+    glDeleteTextures(1, &maskTexture);
+    glDeleteFramebuffers(1, &mapFramebuffer);
+    glDeleteTextures(1, &mapTexture);
+    glDeleteVertexArrays(1, &emptyVAO);
+}
+
+void ShadowMaps::resize(int width, int height) {
+    if (width == this->width && height == this->height) {
+        return;
+    }
+    this->width = width;
+    this->height = height;
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+
+    if (!maskFramebuffer) {
+        glGenTextures(1, &maskTexture);
+        glGenFramebuffers(1, &maskFramebuffer);
+    }
+    glBindTexture(GL_TEXTURE_2D, maskTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // rays from a light off the edge of the window start out in the clear
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, max(width / maskDivisor, 1), max(height / maskDivisor, 1), 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, maskFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, maskTexture, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        cerr << "Shadow mask framebuffer is incomplete" << endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void ShadowMaps::beginOccluders() {
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    glGetIntegerv(GL_VIEWPORT, previousViewport);
+    glBindFramebuffer(GL_FRAMEBUFFER, maskFramebuffer);
+    glViewport(0, 0, max(width / maskDivisor, 1), max(height / maskDivisor, 1));
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+}
+
+void ShadowMaps::endOccluders() {
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+    glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+}
+
+void ShadowMaps::build(const vector<ShadowLight>& lights) {
+    lightCount = min((int)lights.size(), maxLights);
+    if (lightCount == 0 || width <= 0 || height <= 0) {
+        return;
+    }
+    float aspect = (float)width / height;
+    for (int i = 0; i < lightCount; ++i) {
+        const ShadowLight& light = lights[i];
+        float radius = light.radius;
+        if (radius <= 0.0f) {
+            // in NDC heights, so x distances count aspect times over
+            float dx = (fabs(light.x) + 1.0f) * aspect;
+            float dy = fabs(light.y) + 1.0f;
+            radius = sqrt(dx * dx + dy * dy);
+        }
+        float* data = &lightData[i * 4];
+        data[0] = (light.x + 1.0f) * 0.5f;
+        data[1] = (light.y + 1.0f) * 0.5f;
+        data[2] = radius * 0.5f;
+        data[3] = light.strength;
+    }
+
+    GLint previous = 0;
+    GLint viewport[4];
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glBindFramebuffer(GL_FRAMEBUFFER, mapFramebuffer);
+    glViewport(0, 0, resolution, lightCount);
+    glDisable(GL_BLEND);
+
+    glUseProgram(mapShader);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, maskTexture);
+    glUniform1i(uMapOccludersLoc, 0);
+    glUniform4fv(uMapLightsLoc, lightCount, lightData);
+    glUniform1f(uMapAspectLoc, aspect);
+    glUniform1i(uMapResolutionLoc, resolution);
+    glUniform1i(uMapStepsLoc, stepsFor(resolution));
+    glBindVertexArray(emptyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(0);
+
+    glEnable(GL_BLEND);
+    glBindFramebuffer(GL_FRAMEBUFFER, previous);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+void ShadowMaps::apply(float groundTop) {
+    if (lightCount == 0) {
+        return;
+    }
+    glUseProgram(applyShader);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, maskTexture);
+    glUniform1i(uApplyOccludersLoc, 0);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, mapTexture);
+    glUniform1i(uApplyShadowMapLoc, 1);
+    glUniform4fv(uApplyLightsLoc, lightCount, lightData);
+    glUniform1i(uApplyLightCountLoc, lightCount);
+    glUniform1f(uApplyAspectLoc, (float)width / height);
+    glUniform1f(uApplyGroundTopLoc, groundTop);
+
+    // multiplies what's there by the shader's output
+    glBlendFunc(GL_ZERO, GL_SRC_COLOR);
+    glBindVertexArray(emptyVAO);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glBindVertexArray(0);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(0);
+}
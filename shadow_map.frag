@@ -0,0 +1,34 @@
+#version 330 core
+
+// One texel per direction (x) and light (y): how far out a ray from the light
+// gets before the occluder mask stops it, as a fraction of the light's reach.
+out vec4 FragColor;
+
+uniform sampler2D uOccluders;
+uniform vec4 uLights[4];   // centre in texture coordinates, reach in texture heights, strength
+uniform float uAspect;     // window width / height
+uniform int uResolution;
+uniform int uSteps;
+
+const float PI = 3.14159265;
+
+void main() {
+    vec4 light = uLights[int(gl_FragCoord.y)];
+    float angle = gl_FragCoord.x / float(uResolution) * 2.0 * PI - PI;
+    vec2 ray = vec2(cos(angle) / uAspect, sin(angle)) * light.z;
+
+    // a lamp inside the house shines out of it: only what the ray meets once
+    // it's in the open blocks it
+    bool open = false;
+    float nearest = 1.0;
+    for (int i = 1; i <= uSteps; ++i) {
+        float distance = float(i) / float(uSteps);
+        bool blocked = texture(uOccluders, light.xy + ray * distance).a > 0.5;
+        if (blocked && open) {
+            nearest = distance;
+            break;
+        }
+        open = open || !blocked;
+    }
+    FragColor = vec4(nearest, 0.0, 0.0, 1.0);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vector>
+
+// A light that casts shadows: position in NDC, reach in NDC heights (0 reaches
+// the farthest corner of the window, for the sun and moon), and how much its
+// shadow darkens the ground.
+struct ShadowLight {
+    float x;
+    float y;
+    float radius;
+    float strength;
+};
+
+// Soft 2D shadows from 1D polar shadow maps. The occluders are drawn into a
+// mask at a fraction of the window's resolution. Each light then gets a row
+// of a small texture: one texel per direction around it, holding how far a
+// ray in that direction gets before it hits the mask. That's one fullscreen
+// pass over resolution x lights texels, marching the mask on the GPU, so
+// nothing is extruded on the CPU however many dogs there are. The apply pass
+// looks up each ground pixel's direction and distance in every light's row,
+// with a few taps along the angle that spread further from the light (PCF),
+// so shadows start sharp at their caster and soften with distance.
+class ShadowMaps {
+public:
+    static const int maxLights = 4;
+
+    // mapShader and applyShader are the shadow_map and shadow_apply programs;
+    // resolution is the directions per light, and the mask is the window's
+    // size divided by maskDivisor. Needs a current GL context.
+    ShadowMaps(unsigned int mapShader, unsigned int applyShader, int resolution, int maskDivisor);
+    ~ShadowMaps();
+    ShadowMaps(const ShadowMaps&) = delete;
+    ShadowMaps& operator=(const ShadowMaps&) = delete;
+
+    void resize(int width, int height);
+    // Draw calls in between go into the occluder mask: anything drawn with
+    // alpha over one half blocks light. Call outside any other framebuffer's setup.
+    void beginOccluders();
+    void endOccluders();
+    // Marches the mask outward from each light (up to maxLights) into its row.
+    void build(const std::vector<ShadowLight>& lights);
+    // Darkens the bound framebuffer where the lights are blocked, below
+    // groundTop (NDC y). Occluders don't shadow themselves.
+    void apply(float groundTop);
+
+private:
+    unsigned int maskTexture;
+    unsigned int maskFramebuffer;
+    unsigned int mapTexture;
+    unsigned int mapFramebuffer;
+    unsigned int mapShader;
+    unsigned int applyShader;
+    int uMapOccludersLoc;
+    int uMapLightsLoc;
+    int uMapAspectLoc;
+    int uMapResolutionLoc;
+    int uMapStepsLoc;
+    int uApplyOccludersLoc;
+    int uApplyShadowMapLoc;
+    int uApplyLightsLoc;
+    int uApplyLightCountLoc;
+    int uApplyAspectLoc;
+    int uApplyGroundTopLoc;
+    unsigned int emptyVAO;
+    int resolution;
+    int maskDivisor;
+    int width;
+    int height;
+    // per light: centre in texture coordinates, reach in texture heights, strength
+    float lightData[maxLights * 4];
+    int lightCount;
+    int previousFramebuffer;
+    int previousViewport[4];
+};
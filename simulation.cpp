@@ -0,0 +1,220 @@
+#include "simulation.h"
+#include "clock.h"
+#include "input_log.h"
+#include "spsc_queue.h"
+#include "triple_buffer.h"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+using namespace std;
+
+World* world = nullptr;
+const Clock* simulationClock = nullptr;
+RenderState previousState;
+RenderState currentState;
+
+// Main thread -> simulation thread.
+struct QueuedInput {
+    double time;
+    // INPUT_EVENT_KEYS or INPUT_EVENT_FOOD
+    unsigned char type;
+    unsigned int keys;
+    float x;
+    float y;
+};
+SpscQueue<QueuedInput> inputQueue(4096);
+unsigned int liveKeys = 0;
+unsigned int inputSerial = 0;
+double lastInputTime = 0.0;
+double lastChangeTime = 0.0;
+bool changedSincePublish = false;
+void (*sceneChangedCallback)() = nullptr;
+
+// Steps run so far; input is recorded and replayed against it.
+unsigned int simTick = 0;
+InputLog* recording = nullptr;
+unsigned int recordedKeys = 0;
+InputPlayer* replay = nullptr;
+
+// Simulation thread -> render thread.
+TripleBuffer<SceneSnapshot> snapshots;
+atomic<bool> simulationRunning(false);
+thread simulationThread;
+
+void stepSimulation(double stepTime, bool lastInBatch);
+void applyLiveInput(const QueuedInput& input);
+void publishSnapshot(double publishTime);
+void simulationThreadMain();
+
+double simClockNow() {
+    return simulationClock->now();
+}
+
+static void queueInput(const QueuedInput& input) {
+    if (!inputQueue.push(input)) {
+        cerr << "Input queue full, dropping an event" << endl;
+    }
+}
+
+void queueHeldKeys(unsigned int keys, double time) {
+    QueuedInput input = { time, INPUT_EVENT_KEYS, keys, 0.0f, 0.0f };
+    queueInput(input);
+}
+
+void queueFoodSpawn(float x, float y, double time) {
+    QueuedInput input = { time, INPUT_EVENT_FOOD, 0, x, y };
+    queueInput(input);
+}
+
+void initSimulation(int dogCount, int birdCount, unsigned int seed, JobSystem& jobs) {
+    delete world;
+    world = new World(dogCount, seed, birdCount);
+    simTick = 0;
+    world->setJobSystem(&jobs);
+    world->logEvents = true;
+    world->buildFlowFieldInBackground();
+}
+
+void recordInput(InputLog& log) {
+    recording = &log;
+    recording->events.clear();
+    recording->tickCount = 0;
+    recordedKeys = 0;
+}
+
+void replayInput(const InputLog& log) {
+    delete replay;
+    replay = new InputPlayer(log);
+}
+
+void setSceneChangedCallback(void (*callback)()) {
+    sceneChangedCallback = callback;
+}
+
+void startSimulationThread(const Clock& clock) {
+    simulationClock = &clock;
+    currentState = world->renderState();
+    previousState = currentState;
+    publishSnapshot(simClockNow());
+    acquireLatestSnapshot();
+
+    simulationRunning = true;
+    simulationThread = thread(simulationThreadMain);
+}
+
+void stopSimulationThread() {
+    simulationRunning = false;
+    if (simulationThread.joinable()) {
+        simulationThread.join();
+    }
+    delete world;
+    world = nullptr;
+    delete replay;
+    replay = nullptr;
+    recording = nullptr;
+}
+
+bool acquireLatestSnapshot() {
+    return snapshots.update();
+}
+
+const SceneSnapshot& latestSnapshot() {
+    return snapshots.readBuffer();
+}
+
+void simulationThreadMain() {
+    FixedStepper stepper(*simulationClock, simTimestep);
+
+    while (simulationRunning.load()) {
+        int steps = stepper.stepsDue(maxFrameTime);
+        for (int i = 0; i < steps; ++i) {
+            stepSimulation(stepper.lastStepTime() - (steps - 1 - i) * simTimestep, i == steps - 1);
+        }
+
+        if (steps > 0) {
+            publishSnapshot(stepper.lastStepTime());
+        }
+
+        this_thread::sleep_for(chrono::duration<double>(stepper.timeUntilNextStep()));
+    }
+}
+
+void stepSimulation(double stepTime, bool lastInBatch) {
+    if (replay && replay->finished(simTick)) {
+        cout << "Replay finished after " << simTick << " steps" << endl;
+        delete replay;
+        replay = nullptr;
+    }
+
+    // Input up to this step's time goes in before it. The last step of a batch
+    // takes everything queued, so nothing waits for the next wake-up.
+    while (const QueuedInput* input = inputQueue.front()) {
+        if (input->time > stepTime && !lastInBatch) {
+            break;
+        }
+        // live input is dropped while a log plays
+        if (!replay) {
+            applyLiveInput(*input);
+        }
+        inputQueue.pop();
+    }
+    unsigned int keys = replay ? replay->apply(*world, simTick) : liveKeys;
+
+    if (recording) {
+        if (keys != recordedKeys) {
+            InputEvent event = { simTick, INPUT_EVENT_KEYS, keys, 0.0f, 0.0f };
+            recording->events.push_back(event);
+            recordedKeys = keys;
+        }
+        recording->tickCount = simTick + 1;
+    }
+
+    bool wasDay = world->day();
+    previousState = currentState;
+    world->step((float)simTimestep, keys);
+    ++simTick;
+    if (world->sceneChanged()) {
+        lastChangeTime = stepTime;
+        changedSincePublish = true;
+    }
+    currentState = world->renderState();
+    if (wasDay != world->day()) {
+        // sun and moon swap paths on day flip, don't sweep them across the sky
+        previousState = currentState;
+    }
+}
+
+void applyLiveInput(const QueuedInput& input) {
+    if (input.type == INPUT_EVENT_KEYS) {
+        liveKeys = input.keys;
+    }
+    else {
+        world->spawnFood(input.x, input.y);
+        if (recording) {
+            InputEvent event = { simTick, INPUT_EVENT_FOOD, 0, input.x, input.y };
+            recording->events.push_back(event);
+        }
+    }
+    ++inputSerial;
+    lastInputTime = input.time;
+}
+
+void publishSnapshot(double publishTime) {
+    SceneSnapshot& snapshot = snapshots.writeBuffer();
+    snapshot.previous = previousState;
+    snapshot.current = currentState;
+    snapshot.publishTime = publishTime;
+    snapshot.inputSerial = inputSerial;
+    snapshot.inputTime = lastInputTime;
+    snapshot.changeTime = lastChangeTime;
+    world->fillSnapshot(snapshot);
+    snapshots.publish();
+
+    if (changedSincePublish && sceneChangedCallback) {
+        sceneChangedCallback();
+    }
+    changedSincePublish = false;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "world.h"
+
+class Clock;
+class JobSystem;
+struct InputLog;
+
+// The interactive world, stepped at a fixed rate on its own thread.
+
+// Main thread -> simulation thread through a lock-free queue. time is when the
+// input happened, on the simulation clock; each step applies what came before it.
+void queueHeldKeys(unsigned int keys, double time);
+void queueFoodSpawn(float x, float y, double time);
+
+void initSimulation(int dogCount, int birdCount, unsigned int seed, JobSystem& jobs);
+// Call between initSimulation and startSimulationThread. Recording appends
+// every input the simulation consumes to log (read it only after
+// stopSimulationThread). Replaying feeds log back instead of live input until
+// it runs out; log must outlive the simulation thread. Not both at once.
+void recordInput(InputLog& log);
+void replayInput(const InputLog& log);
+// Called on the simulation thread after it publishes a snapshot in which the
+// scene changed (see SceneSnapshot::changeTime); must be thread-safe.
+void setSceneChangedCallback(void (*callback)());
+void startSimulationThread(const Clock& clock);
+void stopSimulationThread();
+// Time on the clock the simulation thread was started with.
+double simClockNow();
+
+// Render thread: swaps in the newest snapshot if one was published since the last call.
+bool acquireLatestSnapshot();
+const SceneSnapshot& latestSnapshot();
@@ -0,0 +1,125 @@
+#include "spatial_hash.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+SpatialHash::SpatialHash(float cellSize, size_t bucketCount)
+    : cellSize(cellSize), count(0) {
+    size_t size = 1;
+    while (size < bucketCount) {
+        size <<= 1;
+    }
+    bucketMask = size - 1;
+    buckets.resize(size);
+    clear();
+}
+
+int SpatialHash::cellCoord(float v) const {
+    return (int)floor(v / cellSize);
+}
+
+size_t SpatialHash::bucketIndex(int cellX, int cellY) const {
+    unsigned int h = (unsigned int)cellX * 73856093u ^ (unsigned int)cellY * 19349663u;
+    return h & bucketMask;
+}
+
+void SpatialHash::insert(EntityId id, float x, float y) {
+    int cellX = cellCoord(x);
+    int cellY = cellCoord(y);
+    Entry entry = { id, x, y };
+    buckets[bucketIndex(cellX, cellY)].push_back(entry);
+
+    if (count == 0) {
+        minCellX = maxCellX = cellX;
+        minCellY = maxCellY = cellY;
+    }
+    else {
+        minCellX = min(minCellX, cellX);
+        maxCellX = max(maxCellX, cellX);
+        minCellY = min(minCellY, cellY);
+        maxCellY = max(maxCellY, cellY);
+    }
+    ++count;
+}
+
+void SpatialHash::remove(EntityId id, float x, float y) {
+    vector<Entry>& bucket = buckets[bucketIndex(cellCoord(x), cellCoord(y))];
+    for (size_t i = 0; i < bucket.size(); ++i) {
+        if (bucket[i].id == id) {
+            bucket[i] = bucket.back();
+            bucket.pop_back();
+            --count;
+            return;
+        }
+    }
+}
+
+void SpatialHash::clear() {
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        buckets[i].clear();
+    }
+    count = 0;
+    minCellX = maxCellX = minCellY = maxCellY = 0;
+}
+
+void SpatialHash::scanCell(int cellX, int cellY, float x, float y, EntityId& best, float& bestDistanceSq) const {
+    // a bucket can hold other cells that hashed to it; they are real candidates too
+    const vector<Entry>& bucket = buckets[bucketIndex(cellX, cellY)];
+    for (size_t i = 0; i < bucket.size(); ++i) {
+        float dx = bucket[i].x - x;
+        float dy = bucket[i].y - y;
+        float distanceSq = dx * dx + dy * dy;
+        if (distanceSq < bestDistanceSq) {
+            bestDistanceSq = distanceSq;
+            best = bucket[i].id;
+        }
+    }
+}
+
+EntityId SpatialHash::nearest(float x, float y, float maxDistance) const {
+    EntityId best = INVALID_ENTITY;
+    if (count == 0) {
+        return best;
+    }
+
+    float bestDistanceSq = maxDistance * maxDistance;
+    int cellX = cellCoord(x);
+    int cellY = cellCoord(y);
+    int maxRing = max(max(abs(cellX - minCellX), abs(cellX - maxCellX)),
+                      max(abs(cellY - minCellY), abs(cellY - maxCellY)));
+    if (maxDistance < INFINITY) {
+        maxRing = min(maxRing, (int)ceil(maxDistance / cellSize) + 1);
+    }
+
+    // Visit square rings of cells around the query point. Anything in ring r+1
+    // is at least r cells away, so once the best hit is that close we're done.
+    for (int ring = 0; ring <= maxRing; ++ring) {
+        int x0 = max(cellX - ring, minCellX);
+        int x1 = min(cellX + ring, maxCellX);
+        int y0 = max(cellY - ring, minCellY);
+        int y1 = min(cellY + ring, maxCellY);
+        for (int cy = y0; cy <= y1; ++cy) {
+            if (cy == cellY - ring || cy == cellY + ring) {
+                for (int cx = x0; cx <= x1; ++cx) {
+                    scanCell(cx, cy, x, y, best, bestDistanceSq);
+                }
+            }
+            else {
+                if (cellX - ring >= minCellX) {
+                    scanCell(cellX - ring, cy, x, y, best, bestDistanceSq);
+                }
+                if (cellX + ring <= maxCellX) {
+                    scanCell(cellX + ring, cy, x, y, best, bestDistanceSq);
+                }
+            }
+        }
+
+        float reach = ring * cellSize;
+        if (best != INVALID_ENTITY && bestDistanceSq <= reach * reach) {
+            break;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#include "entities.h"
+
+// Uniform grid over the plane, hashed into a fixed table of buckets, for
+// nearest-point queries on entities that come and go (e.g. unclaimed food).
+// Entries carry their own position so a query never touches the entity pools.
+class SpatialHash {
+public:
+    // bucketCount is rounded up to a power of two
+    SpatialHash(float cellSize, size_t bucketCount);
+
+    void insert(EntityId id, float x, float y);
+    // x, y must be the position the entity was inserted with
+    void remove(EntityId id, float x, float y);
+    void clear();
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    // Closest entry to (x, y) no further than maxDistance, or INVALID_ENTITY if there is none.
+    EntityId nearest(float x, float y, float maxDistance = INFINITY) const;
+
+private:
+    struct Entry {
+        EntityId id;
+        float x;
+        float y;
+    };
+
+    int cellCoord(float v) const;
+    size_t bucketIndex(int cellX, int cellY) const;
+    void scanCell(int cellX, int cellY, float x, float y, EntityId& best, float& bestDistanceSq) const;
+
+    float cellSize;
+    size_t bucketMask;
+    std::vector<std::vector<Entry>> buckets;
+    size_t count;
+    // cell-space bounds of everything inserted since the last clear; queries never look outside them
+    int minCellX;
+    int maxCellX;
+    int minCellY;
+    int maxCellY;
+};
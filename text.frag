@@ -1,12 +1,13 @@
 #version 330 core
 in vec2 TexCoords;
 
-out vec4 FragColor;
-
 uniform sampler2D text;
 uniform vec3 textColor;
 
+// in oit_write.frag
+void writeColor(vec4 color);
+
 void main() {
     float alpha = texture(text, TexCoords).r;
-    FragColor = vec4(textColor, alpha);
+    writeColor(vec4(textColor, alpha));
 }
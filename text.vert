@@ -4,8 +4,10 @@ layout (location = 0) in vec4 vertex;
 out vec2 TexCoords;
 
 uniform mat4 projection;
+uniform float uDepth;
 
 void main() {
     gl_Position = projection * vec4(vertex.xy, 0.0, 1.0);
+    gl_Position.z = uDepth * gl_Position.w;
     TexCoords = vertex.zw;
 }
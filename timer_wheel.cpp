@@ -0,0 +1,138 @@
+#include "timer_wheel.h"
+
+using namespace std;
+
+static const unsigned int NODE_BITS = 22;
+static const unsigned int NODE_MASK = (1u << NODE_BITS) - 1;
+static const unsigned int GENERATION_MASK = (1u << (32 - NODE_BITS)) - 1;
+static const unsigned int NONE = 0xFFFFFFFFu;
+
+static const unsigned int firstLevelBits = 8;
+static const unsigned int levelBits = 6;
+static const unsigned int levels = 4;
+static const unsigned int firstLevelSlots = 1u << firstLevelBits;
+static const unsigned int levelSlots = 1u << levelBits;
+static const unsigned long long maxDelay = (1ull << (firstLevelBits + (levels - 1) * levelBits)) - 1;
+
+// ticks covered by one slot of the given level (level 0 is one tick)
+static unsigned int levelShift(unsigned int level) {
+    return level == 0 ? 0 : firstLevelBits + (level - 1) * levelBits;
+}
+
+static unsigned int levelBase(unsigned int level) {
+    return level == 0 ? 0 : firstLevelSlots + (level - 1) * levelSlots;
+}
+
+TimerWheel::TimerWheel()
+    : slotHeads(firstLevelSlots + (levels - 1) * levelSlots, NONE),
+      current(0),
+      count(0) {
+}
+
+TimerId TimerWheel::schedule(unsigned int delay, int kind, unsigned int target) {
+    unsigned int node;
+    if (!freeNodes.empty()) {
+        node = freeNodes.back();
+        freeNodes.pop_back();
+    }
+    else {
+        node = (unsigned int)timers.size();
+        timers.push_back(Timer());
+        generations.push_back(0);
+    }
+
+    unsigned long long ticks = delay == 0 ? 1 : (delay > maxDelay ? maxDelay : delay);
+    Timer& timer = timers[node];
+    timer.due = current + ticks;
+    timer.event.kind = kind;
+    timer.event.target = target;
+    link(node);
+    ++count;
+    return (generations[node] << NODE_BITS) | node;
+}
+
+bool TimerWheel::pending(TimerId id) const {
+    unsigned int node = id & NODE_MASK;
+    return id != INVALID_TIMER && node < timers.size() && generations[node] == (id >> NODE_BITS) &&
+           timers[node].slot != NONE;
+}
+
+void TimerWheel::cancel(TimerId id) {
+    if (pending(id)) {
+        unsigned int node = id & NODE_MASK;
+        unlink(node);
+        release(node);
+    }
+}
+
+void TimerWheel::advance(vector<TimerEvent>& fired) {
+    ++current;
+
+    // each time a level wraps, pull the next slot of the level above down into it
+    for (unsigned int level = 1; level < levels; ++level) {
+        unsigned long long below = current & ((1ull << levelShift(level)) - 1);
+        if (below != 0) {
+            break;
+        }
+        cascade(levelBase(level) + (unsigned int)((current >> levelShift(level)) & (levelSlots - 1)));
+    }
+
+    unsigned int slot = (unsigned int)(current & (firstLevelSlots - 1));
+    unsigned int node = slotHeads[slot];
+    slotHeads[slot] = NONE;
+    while (node != NONE) {
+        unsigned int next = timers[node].next;
+        fired.push_back(timers[node].event);
+        release(node);
+        node = next;
+    }
+}
+
+void TimerWheel::link(unsigned int node) {
+    Timer& timer = timers[node];
+    unsigned long long delta = timer.due - current;
+    unsigned int level = 0;
+    while (level + 1 < levels && delta >= (1ull << levelShift(level + 1))) {
+        ++level;
+    }
+    unsigned int mask = (level == 0 ? firstLevelSlots : levelSlots) - 1;
+    unsigned int slot = levelBase(level) + (unsigned int)((timer.due >> levelShift(level)) & mask);
+
+    timer.slot = slot;
+    timer.prev = NONE;
+    timer.next = slotHeads[slot];
+    if (timer.next != NONE) {
+        timers[timer.next].prev = node;
+    }
+    slotHeads[slot] = node;
+}
+
+void TimerWheel::unlink(unsigned int node) {
+    Timer& timer = timers[node];
+    if (timer.prev != NONE) {
+        timers[timer.prev].next = timer.next;
+    }
+    else {
+        slotHeads[timer.slot] = timer.next;
+    }
+    if (timer.next != NONE) {
+        timers[timer.next].prev = timer.prev;
+    }
+}
+
+void TimerWheel::release(unsigned int node) {
+    timers[node].slot = NONE;
+    generations[node] = (generations[node] + 1) & GENERATION_MASK;
+    freeNodes.push_back(node);
+    --count;
+}
+
+void TimerWheel::cascade(unsigned int slot) {
+    unsigned int node = slotHeads[slot];
+    slotHeads[slot] = NONE;
+    while (node != NONE) {
+        unsigned int next = timers[node].next;
+        link(node);
+        node = next;
+    }
+}
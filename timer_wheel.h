@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Handle to a scheduled timer; like EntityId, the high bits are a generation
+// so a handle to a timer that already fired or was cancelled goes stale.
+typedef unsigned int TimerId;
+const TimerId INVALID_TIMER = 0xFFFFFFFFu;
+
+// What a timer hands back when it fires: a caller-defined kind and the id of
+// whatever it belongs to (e.g. a dog).
+struct TimerEvent {
+    int kind;
+    unsigned int target;
+};
+
+// Hierarchical timer wheel counting in ticks. The first level has a slot per
+// tick for the next 256 ticks, each higher level has 64 slots that are each a
+// whole turn of the level below; when a level wraps, the next slot up is
+// cascaded down. Scheduling and cancelling are O(1) and a tick only touches
+// the timers that come due (plus the occasional cascade).
+class TimerWheel {
+public:
+    TimerWheel();
+
+    // Fires delay ticks from now (at least one). Delays past the wheel's range,
+    // about 67 million ticks, are clamped to it.
+    TimerId schedule(unsigned int delay, int kind, unsigned int target);
+    // Does nothing if the timer already fired or was cancelled.
+    void cancel(TimerId id);
+    bool pending(TimerId id) const;
+
+    // Moves on one tick and appends every timer that came due to fired.
+    void advance(std::vector<TimerEvent>& fired);
+
+    unsigned long long now() const { return current; }
+    size_t size() const { return count; }
+
+private:
+    struct Timer {
+        unsigned long long due;
+        TimerEvent event;
+        unsigned int slot;
+        unsigned int prev;
+        unsigned int next;
+    };
+
+    void link(unsigned int node);
+    void unlink(unsigned int node);
+    void release(unsigned int node);
+    void cascade(unsigned int slot);
+
+    std::vector<Timer> timers;
+    std::vector<unsigned int> generations;
+    std::vector<unsigned int> freeNodes;
+    // head node of every slot, first level then each higher level in turn
+    std::vector<unsigned int> slotHeads;
+    unsigned long long current;
+    size_t count;
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+
+// Single-producer / single-consumer triple buffer. The writer always has a
+// private slot to fill, the reader always has a private slot to read, and the
+// third slot is handed between them with one atomic exchange, so neither side
+// ever blocks or sees a half-written value.
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() : middle(1), writeIndex(0), readIndex(2) {}
+
+    // Writer side: fill writeBuffer(), then publish() it.
+    T& writeBuffer() { return buffers[writeIndex]; }
+
+    void publish() {
+        int previous = middle.exchange(writeIndex | FRESH_BIT, std::memory_order_acq_rel);
+        writeIndex = previous & INDEX_MASK;
+    }
+
+    // Reader side: update() swaps in the newest published slot, if any.
+    bool update() {
+        if ((middle.load(std::memory_order_acquire) & FRESH_BIT) == 0) {
+            return false;
+        }
+        int previous = middle.exchange(readIndex, std::memory_order_acq_rel);
+        readIndex = previous & INDEX_MASK;
+        return true;
+    }
+
+    const T& readBuffer() const { return buffers[readIndex]; }
+
+private:
+    static const int INDEX_MASK = 3;
+    static const int FRESH_BIT = 4;
+
+    T buffers[3];
+    std::atomic<int> middle;
+    int writeIndex;
+    int readIndex;
+};
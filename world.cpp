@@ -0,0 +1,619 @@
+#include "world.h"
+#include "curves.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+const float transitionDuration = 5.0f;
+const float daySkyColor[3] = { 0.412f, 0.737f, 0.851f };
+const float nightSkyColor[3] = { 0.0f, 0.0f, 0.1f };
+// Speeds are in NDC units per second; the old per-frame values were tuned on a 60 Hz vsync'd display.
+const float dogSpeed = 0.18f;
+const float dogWalkSpeed = 0.12f;
+const float paintSpeed = 0.6f;
+const float dogMinX = -0.1f;
+const float dogMaxX = 1.3f;
+const float dogCenterX = -0.65f;
+const float dogTopOffsetY = -0.55f;
+const float foodRestY = -0.7f;
+const float zSpawnInterval = 1.5f; // spawn a new "Z" every second
+const float zLifetime = 2.0f;
+const float foodCellSize = 0.01f;
+const size_t foodBuckets = 4096;
+// the flow field covers the grass strip
+const float fieldMinX = -1.0f;
+const float fieldMaxX = 1.0f;
+const float fieldMinY = -0.8f;
+const float fieldMaxY = -0.55f;
+const float fieldCellSize = 2.0f / 256.0f;
+// a dog following the field claims food once it is this close
+const float foodReach = 2.0f * fieldCellSize;
+// claims change the goal set nearly every step with many dogs; batch them up
+const float fieldRebuildInterval = 0.1f;
+const float foodGravity = 3.0f;
+// Dogs stand in lanes over the depth of the lawn. Their collision box is the
+// body, not the whole sprite, so a crowd can still squeeze together a bit.
+const float dogLaneDepth = 0.06f;
+const float dogBodyHalfWidth = 0.05f;
+const float dogBodyHalfHeight = 0.015f;
+const float dogSeparation = 0.5f;
+// x-overlapping dog pairs the broadphase tests per step. A crowd piled up deeper
+// than the lawn has lanes makes pairs quadratically; past this, each dog is
+// only tested against its nearest neighbours in x.
+const size_t maxDogContactCandidates = 1 << 17;
+
+enum TimerKind {
+    TIMER_DAY_NIGHT,
+    TIMER_Z_SPAWN,
+    TIMER_Z_EXPIRE,
+    TIMER_DONE_EATING,
+    TIMER_FIELD_READY
+};
+
+static unsigned int ticksFor(float seconds) {
+    return (unsigned int)(seconds / simTimestep + 0.5);
+}
+
+// Tracks over the day/night transition progress. The body that sets arcs over
+// to the right and speeds up, the other one rises into its spot; the sky goes
+// through a sunset on the way to night and a dawn on the way back.
+struct SkyCurves {
+    Curve settingX;
+    Curve settingY;
+    Curve risingX;
+    Curve risingY;
+    Curve dusk[3];
+    Curve dawn[3];
+
+    SkyCurves() {
+        const float sunset[3] = { 0.85f, 0.45f, 0.35f };
+        const float sunrise[3] = { 0.75f, 0.5f, 0.6f };
+
+        settingX.key(0.0f, -0.8f, 0.5f).key(1.0f, 1.2f, 3.5f);
+        settingY.key(0.0f, 0.8f, 0.25f).key(0.4f, 0.85f).key(1.0f, 0.6f, -0.8f);
+        risingX.key(0.0f, -1.2f, 0.8f).key(1.0f, -0.8f);
+        risingY.key(0.0f, 0.6f, 0.5f).key(1.0f, 0.8f);
+        for (int i = 0; i < 3; ++i) {
+            dusk[i].key(0.0f, daySkyColor[i]).key(0.5f, sunset[i]).key(1.0f, nightSkyColor[i]);
+            dawn[i].key(0.0f, nightSkyColor[i]).key(0.5f, sunrise[i]).key(1.0f, daySkyColor[i]);
+        }
+    }
+};
+
+static const SkyCurves& skyCurves() {
+    static SkyCurves curves;
+    return curves;
+}
+
+World::World(int dogCount, unsigned int seed, int birdCount)
+    : birds(birdCount, seed * 2654435761u),
+      freeFood(foodCellSize, foodBuckets),
+      foodField(fieldMinX, fieldMinY, fieldMaxX, fieldMaxY, fieldCellSize),
+      foodFieldWorker(nullptr),
+      jobs(nullptr),
+      freeFoodChanged(false),
+      lastFieldBuildTime(0.0),
+      dayNightTimer(INVALID_TIMER),
+      zSpawnTimer(INVALID_TIMER),
+      fieldReadyTimer(INVALID_TIMER),
+      skippedContacts(0),
+      rng(seed),
+      simTime(0.0),
+      isDay(true),
+      keyPressed(false),
+      changed(true),
+      transitionInProgress(false),
+      transparencyEnabled(false),
+      lightEnabled(false),
+      selectedRoom(-1),
+      paintProgress(0.0f),
+      dimFactor(1.0f),
+      transitionStartTime(0.0f),
+      sunMoonProgress(0.0f) {
+    logEvents = false;
+    for (int i = 0; i < 3; ++i) {
+        skyColor[i] = daySkyColor[i];
+    }
+
+    dogs.reserve(dogCount);
+    for (int i = 0; i < dogCount; ++i) {
+        // the first dog keeps its old spot, the rest are spread along the yard
+        float x = 0.0f;
+        float lane = 0.0f;
+        if (i > 0) {
+            x = dogMinX + (dogMaxX - dogMinX) * fmod(i * 0.618034f, 1.0f);
+            lane = -dogLaneDepth * fmod(i * 0.7548777f, 1.0f);
+        }
+        dogs.create(x, lane);
+        awakeDogs.push_back((unsigned int)i);
+    }
+
+    smokes.create(0.125f, 0.33f);
+}
+
+World::~World() {
+    delete foodFieldWorker;
+}
+
+void World::buildFlowFieldInBackground() {
+    if (!foodFieldWorker) {
+        foodFieldWorker = new FlowFieldWorker(foodField);
+    }
+}
+
+int World::randomInt(int n) {
+    return (int)rng.below((unsigned int)n);
+}
+
+void World::step(float dt, unsigned int keys) {
+    simTime += dt;
+    dogs.storePreviousPositions();
+    size_t foodCount = foods.size();
+    size_t zCount = zLetters.size();
+
+    applyInput(keys, dt);
+    runTimers();
+    updateDayNight();
+    birds.step(dt, jobs);
+    updateFallingFood(dt);
+
+    if (isDay) {
+        animateDogs(dt);
+        separateDogs();
+    }
+
+    // one background build at a time; its result lands on a fixed step, see TIMER_FIELD_READY
+    bool fieldBuilding = timers.pending(fieldReadyTimer);
+    if (freeFoodChanged && !fieldBuilding && (simTime - lastFieldBuildTime >= fieldRebuildInterval || !foodField.ready())) {
+        rebuildFlowField();
+        freeFoodChanged = false;
+        lastFieldBuildTime = simTime;
+    }
+
+    // Z letters rise and birds fly every step; dogs only while they walk
+    changed = keys != 0 || transitionInProgress || !fallingFood.empty() || birds.size() > 0 || zCount > 0 ||
+              foods.size() != foodCount || zLetters.size() != zCount || dogsMoved();
+}
+
+bool World::dogsMoved() const {
+    for (size_t i = 0; i < dogs.size(); ++i) {
+        if (dogs.posX[i] != dogs.prevX[i] || dogs.posY[i] != dogs.prevY[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void World::applyInput(unsigned int keys, float dt) {
+    if (keys & INPUT_PAINT_UP) {
+        paintProgress = clip(paintProgress + paintSpeed * dt, 0.0f, 1.0f);
+    }
+    if (keys & INPUT_PAINT_DOWN) {
+        paintProgress = clip(paintProgress - paintSpeed * dt, 0.0f, 1.0f);
+    }
+    if ((keys & INPUT_TOGGLE_NIGHT) && !keyPressed) {
+        keyPressed = true;
+        transitionInProgress = true;
+        lightEnabled = !lightEnabled;
+        selectedRoom = randomInt(7);
+        transitionStartTime = simTime;
+        // pressing again mid-transition starts it over
+        timers.cancel(dayNightTimer);
+        dayNightTimer = timers.schedule(ticksFor(transitionDuration), TIMER_DAY_NIGHT, 0);
+        if (logEvents) {
+            cout << "Toggled day/night: " << (isDay ? "Day" : "Night") << endl;
+        }
+    }
+    if (!(keys & INPUT_TOGGLE_NIGHT)) {
+        keyPressed = false;
+    }
+    if (isDay && !dogs.empty()) {
+        if (keys & INPUT_MOVE_LEFT) {
+            dogs.posX[0] = clip(dogs.posX[0] - dogSpeed * dt, dogMinX, dogMaxX);
+            dogs.sprite[0] |= SPRITE_FLIP;
+        }
+        if (keys & INPUT_MOVE_RIGHT) {
+            dogs.posX[0] = clip(dogs.posX[0] + dogSpeed * dt, dogMinX, dogMaxX);
+            dogs.sprite[0] &= ~SPRITE_FLIP;
+        }
+    }
+
+    if (keys & INPUT_SHOW_CHARACTER) {
+        transparencyEnabled = true;
+        selectedRoom = randomInt(7);
+    }
+    if (keys & INPUT_HIDE_CHARACTER) {
+        transparencyEnabled = false;
+        selectedRoom = -1;
+    }
+    if (keys & INPUT_TOGGLE_NIGHT) {
+        transparencyEnabled = false;
+    }
+}
+
+void World::runTimers() {
+    firedTimers.clear();
+    timers.advance(firedTimers);
+
+    for (size_t i = 0; i < firedTimers.size(); ++i) {
+        const TimerEvent& event = firedTimers[i];
+        switch (event.kind) {
+        case TIMER_DAY_NIGHT:
+            transitionInProgress = false;
+            isDay = !isDay;
+            if (isDay) {
+                timers.cancel(zSpawnTimer);
+                zLetters.clear();
+            }
+            else {
+                zSpawnTimer = timers.schedule(ticksFor(zSpawnInterval), TIMER_Z_SPAWN, 0);
+            }
+            break;
+
+        case TIMER_Z_SPAWN:
+            spawnZLetters();
+            zSpawnTimer = timers.schedule(ticksFor(zSpawnInterval), TIMER_Z_SPAWN, 0);
+            break;
+
+        case TIMER_Z_EXPIRE:
+            // letters cleared at daybreak leave their timers behind
+            zLetters.destroy(event.target);
+            break;
+
+        case TIMER_DONE_EATING: {
+            size_t dog = dogs.indexOf(event.target);
+            dogs.state[dog] = DOG_RETURNING;
+            foods.destroy(dogs.link[dog]);
+            dogs.link[dog] = INVALID_ENTITY;
+            wakeDog(dog);
+            break;
+        }
+
+        case TIMER_FIELD_READY:
+            foodFieldWorker->waitForResult(foodField);
+            break;
+        }
+    }
+}
+
+void World::updateDayNight() {
+    sunMoonProgress = 0.0f;
+    if (transitionInProgress) {
+        sunMoonProgress = std::min((float)(simTime - transitionStartTime) / transitionDuration, 1.0f);
+    }
+
+    if (isDay) {
+        dimFactor = 1.0f - 0.5f * sunMoonProgress;
+    }
+    else {
+        dimFactor = 0.5f + 0.5f * sunMoonProgress;
+    }
+
+    const SkyCurves& curves = skyCurves();
+    for (int i = 0; i < 3; ++i) {
+        skyColor[i] = (isDay ? curves.dusk[i] : curves.dawn[i]).sample(sunMoonProgress);
+    }
+}
+
+void World::spawnZLetters() {
+    for (size_t i = 0; i < dogs.size(); ++i) {
+        float xOffset = (randomInt(100) / 100.0f - 0.5f) * 0.04f; // Random horizontal offset
+        float x = getDogCenter(dogs.posX[i], (dogs.sprite[i] & SPRITE_FLIP) != 0) - xOffset;
+        EntityId z = zLetters.create(x, dogs.posY[i] + dogTopOffsetY + 0.05f);
+        // timer is the spawn time, the renderer fades letters by age
+        zLetters.timer[zLetters.indexOf(z)] = (float)simTime;
+        timers.schedule(ticksFor(zLifetime), TIMER_Z_EXPIRE, z);
+    }
+}
+
+void World::spawnFood(float xFood, float y) {
+    EntityId food = foods.create(xFood, std::max(y, foodRestY));
+    if (y > foodRestY) {
+        foods.state[foods.indexOf(food)] = FOOD_FALLING;
+        fallingFood.push_back(food);
+    }
+    else {
+        landFood(foods.indexOf(food));
+    }
+    if (logEvents) {
+        cout << "Food spawned at x :" << xFood << " , y:" << y << endl;
+    }
+}
+
+void World::landFood(size_t f) {
+    foods.posY[f] = foodRestY;
+    foods.prevY[f] = foodRestY;
+    foods.velY[f] = 0.0f;
+    foods.state[f] = FOOD_FREE;
+    freeFood.insert(foods.idAt(f), foods.posX[f], foodRestY);
+    freeFoodChanged = true;
+
+    for (size_t i = 0; i < dogsWaitingForFood.size(); ++i) {
+        wakeDog(dogsWaitingForFood[i]);
+    }
+    dogsWaitingForFood.clear();
+}
+
+void World::updateFallingFood(float dt) {
+    for (size_t i = fallingFood.size(); i-- > 0;) {
+        size_t f = foods.indexOf(fallingFood[i]);
+        foods.prevY[f] = foods.posY[f];
+        foods.velY[f] -= foodGravity * dt;
+        foods.posY[f] += foods.velY[f] * dt;
+        if (foods.posY[f] <= foodRestY) {
+            landFood(f);
+            fallingFood[i] = fallingFood.back();
+            fallingFood.pop_back();
+        }
+    }
+}
+
+void World::separateDogs() {
+    size_t count = dogs.size();
+    bodyX.resize(count);
+    bodyY.resize(count);
+    bodyMinX.resize(count);
+    bodyMaxX.resize(count);
+    bodyMinY.resize(count);
+    bodyMaxY.resize(count);
+    bodyFixedX.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        bodyX[i] = getDogMidpoint(dogs.posX[i]);
+        bodyY[i] = dogs.posY[i];
+        bodyMinX[i] = bodyX[i] - dogBodyHalfWidth;
+        bodyMaxX[i] = bodyX[i] + dogBodyHalfWidth;
+        bodyMinY[i] = bodyY[i] - dogBodyHalfHeight;
+        bodyMaxY[i] = bodyY[i] + dogBodyHalfHeight;
+        // a dog with somewhere to be only sidesteps, so a crowd can't keep it from its food or home
+        bodyFixedX[i] = dogs.state[i] != DOG_IDLE;
+    }
+
+    const vector<BodyPair>& pairs = dogBroadphase.findPairs(bodyMinX, bodyMaxX, bodyMinY, bodyMaxY, maxDogContactCandidates);
+    skippedContacts += dogBroadphase.skippedCandidates();
+    if (pairs.empty()) {
+        return;
+    }
+    buildContactBatches(pairs, count, dogContacts);
+    separateBodies(dogContacts, bodyX, bodyY, bodyFixedX, dogBodyHalfWidth, dogBodyHalfHeight, dogSeparation, jobs);
+
+    for (size_t i = 0; i < count; ++i) {
+        dogs.posX[i] += bodyX[i] - getDogMidpoint(dogs.posX[i]);
+        dogs.posY[i] = clip(bodyY[i], -dogLaneDepth, 0.0f);
+    }
+}
+
+void World::rebuildFlowField() {
+    vector<float> goalX;
+    vector<float> goalY;
+    goalX.reserve(freeFood.size());
+    goalY.reserve(freeFood.size());
+    for (size_t f = 0; f < foods.size(); ++f) {
+        if (foods.state[f] == FOOD_FREE) {
+            goalX.push_back(foods.posX[f]);
+            goalY.push_back(foods.posY[f]);
+        }
+    }
+
+    if (foodFieldWorker) {
+        foodFieldWorker->request(goalX, goalY);
+        fieldReadyTimer = timers.schedule(ticksFor(fieldRebuildInterval), TIMER_FIELD_READY, 0);
+    }
+    else {
+        foodField.build(goalX, goalY);
+    }
+}
+
+bool World::claimFoodInReach(size_t dog) {
+    EntityId food = freeFood.nearest(getDogMidpoint(dogs.posX[dog]), foodRestY, foodReach);
+    if (food == INVALID_ENTITY) {
+        return false;
+    }
+
+    size_t f = foods.indexOf(food);
+    freeFood.remove(food, foods.posX[f], foods.posY[f]);
+    foods.state[f] = FOOD_CLAIMED;
+    dogs.link[dog] = food;
+    freeFoodChanged = true;
+    return true;
+}
+
+void World::followFlowField(size_t dog, float dt) {
+    float dirX, dirY;
+    foodField.direction(getDogMidpoint(dogs.posX[dog]), foodRestY, dirX, dirY);
+
+    // dogs stay on the ground line, only the horizontal part of the field matters
+    dogs.velX[dog] = 0.0f;
+    if (dirX != 0.0f) {
+        dogs.velX[dog] = (dirX < 0) ? -dogWalkSpeed : dogWalkSpeed;
+        dogs.posX[dog] += dogs.velX[dog] * dt;
+        if (dirX < 0) dogs.sprite[dog] |= SPRITE_FLIP;
+        else dogs.sprite[dog] &= ~SPRITE_FLIP;
+    }
+}
+
+bool World::walkDogTo(size_t dog, float targetCenterX, float dt) {
+    const float epsilon = 0.001f;
+    // Face the target as seen from the middle of the body. The center jumps when
+    // the sprite flips, so deciding from the center itself can flip back and forth.
+    bool goingLeft = targetCenterX < getDogMidpoint(dogs.posX[dog]);
+    if (goingLeft) dogs.sprite[dog] |= SPRITE_FLIP;
+    else dogs.sprite[dog] &= ~SPRITE_FLIP;
+    float dx = targetCenterX - getDogCenter(dogs.posX[dog], goingLeft);
+
+    if (fabs(dx) > epsilon) {
+        float step = std::min(dogWalkSpeed * dt, (float)fabs(dx));
+        dogs.velX[dog] = (dx < 0) ? -dogWalkSpeed : dogWalkSpeed;
+        dogs.posX[dog] += (dx / fabs(dx)) * step;
+        return false;
+    }
+
+    dogs.velX[dog] = 0.0f;
+    dogs.posX[dog] = targetCenterX - getDogCenter(0.0f, goingLeft);
+    return true;
+}
+
+void World::wakeDog(size_t dog) {
+    awakeDogs.push_back((unsigned int)dog);
+}
+
+void World::animateDogs(float dt) {
+    size_t kept = 0;
+    for (size_t n = 0; n < awakeDogs.size(); ++n) {
+        unsigned int dog = awakeDogs[n];
+        if (resumeDog(dog, dt)) {
+            awakeDogs[kept++] = dog;
+        }
+    }
+    awakeDogs.resize(kept);
+}
+
+// Runs one step of a dog's behaviour. Returns false once the dog has parked
+// itself to wait for something, which is what wakes it up again.
+bool World::resumeDog(size_t i, float dt) {
+    switch (dogs.state[i]) {
+    case DOG_IDLE:
+        if (freeFood.empty()) {
+            dogsWaitingForFood.push_back((unsigned int)i);
+            return false;
+        }
+        dogs.param[i] = getDogCenter(dogs.posX[i], (dogs.sprite[i] & SPRITE_FLIP) != 0);
+        dogs.link[i] = INVALID_ENTITY;
+        dogs.state[i] = DOG_MOVING_TO_FOOD;
+        return true;
+
+    case DOG_MOVING_TO_FOOD:
+        if (dogs.link[i] == INVALID_ENTITY) {
+            // still hunting: follow the field until some food is in reach
+            if (freeFood.empty()) {
+                dogs.state[i] = DOG_RETURNING;
+            }
+            else if (!claimFoodInReach(i)) {
+                followFlowField(i, dt);
+            }
+        }
+        else if (!foods.alive(dogs.link[i])) {
+            dogs.state[i] = DOG_RETURNING;
+        }
+        else if (walkDogTo(i, foods.posX[foods.indexOf(dogs.link[i])], dt)) {
+            dogs.state[i] = DOG_EATING;
+            float eatingTime = 3.0f + static_cast<float>(randomInt(200)) / 100.0f;
+            timers.schedule(ticksFor(eatingTime), TIMER_DONE_EATING, dogs.idAt(i));
+            return false;
+        }
+        return true;
+
+    case DOG_EATING:
+        // TIMER_DONE_EATING sends the dog home
+        return false;
+
+    case DOG_RETURNING:
+        if (walkDogTo(i, dogs.param[i], dt)) {
+            dogs.state[i] = DOG_IDLE;
+        }
+        return true;
+    }
+    return true;
+}
+
+RenderState World::renderState() const {
+    RenderState state;
+    calculateSunMoonPosition(sunMoonProgress, state.sunX, state.sunY, state.moonX, state.moonY);
+    for (int i = 0; i < 3; ++i) {
+        state.skyColor[i] = skyColor[i];
+    }
+    state.time = (float)simTime;
+    return state;
+}
+
+void World::fillSnapshot(SceneSnapshot& snapshot) const {
+    snapshot.isDay = isDay;
+    snapshot.transparencyEnabled = transparencyEnabled;
+    snapshot.lightEnabled = lightEnabled;
+    snapshot.selectedRoom = selectedRoom;
+    snapshot.paintProgress = paintProgress;
+    snapshot.sunMoonProgress = sunMoonProgress;
+
+    snapshot.dogPrevX.assign(dogs.prevX.begin(), dogs.prevX.end());
+    snapshot.dogPrevY.assign(dogs.prevY.begin(), dogs.prevY.end());
+    snapshot.dogX.assign(dogs.posX.begin(), dogs.posX.end());
+    snapshot.dogY.assign(dogs.posY.begin(), dogs.posY.end());
+    snapshot.dogSprite.assign(dogs.sprite.begin(), dogs.sprite.end());
+    snapshot.foodX.assign(foods.posX.begin(), foods.posX.end());
+    snapshot.foodPrevY.assign(foods.prevY.begin(), foods.prevY.end());
+    snapshot.foodY.assign(foods.posY.begin(), foods.posY.end());
+    snapshot.zX.assign(zLetters.posX.begin(), zLetters.posX.end());
+    snapshot.zY.assign(zLetters.posY.begin(), zLetters.posY.end());
+    snapshot.zStartTime.assign(zLetters.timer.begin(), zLetters.timer.end());
+    snapshot.smokeX.assign(smokes.posX.begin(), smokes.posX.end());
+    snapshot.smokeY.assign(smokes.posY.begin(), smokes.posY.end());
+    snapshot.birdPrevX.assign(birds.prevX.begin(), birds.prevX.end());
+    snapshot.birdPrevY.assign(birds.prevY.begin(), birds.prevY.end());
+    snapshot.birdX.assign(birds.posX.begin(), birds.posX.end());
+    snapshot.birdY.assign(birds.posY.begin(), birds.posY.end());
+}
+
+void World::calculateSunMoonPosition(float progress, float& sunX, float& sunY, float& moonX, float& moonY) const {
+    // by day the sun sets and the moon rises, at night the other way around
+    const SkyCurves& curves = skyCurves();
+    const Curve& sunPathX = isDay ? curves.settingX : curves.risingX;
+    const Curve& sunPathY = isDay ? curves.settingY : curves.risingY;
+    const Curve& moonPathX = isDay ? curves.risingX : curves.settingX;
+    const Curve& moonPathY = isDay ? curves.risingY : curves.settingY;
+
+    sunX = sunPathX.sample(progress);
+    sunY = sunPathY.sample(progress);
+    moonX = moonPathX.sample(progress);
+    moonY = moonPathY.sample(progress);
+}
+
+RenderState interpolateRenderState(const RenderState& a, const RenderState& b, float alpha) {
+    RenderState state;
+    state.sunX = lerp(a.sunX, b.sunX, alpha);
+    state.sunY = lerp(a.sunY, b.sunY, alpha);
+    state.moonX = lerp(a.moonX, b.moonX, alpha);
+    state.moonY = lerp(a.moonY, b.moonY, alpha);
+    for (int i = 0; i < 3; ++i) {
+        state.skyColor[i] = lerp(a.skyColor[i], b.skyColor[i], alpha);
+    }
+    state.time = lerp(a.time, b.time, alpha);
+    return state;
+}
+
+float clip(float n, float lower, float upper) {
+    return std::max(lower, std::min(n, upper));
+}
+
+float lerp(float a, float b, float t) {
+    return a + (b - a) * t;
+}
+
+float getDogMidpoint(float dogX) {
+    return 0.5f * (getDogCenter(dogX, false) + getDogCenter(dogX, true));
+}
+
+float getDogCenter(float dogX, bool dogGoingLeft) {
+    float localX = -0.56;
+    float center;
+
+    if (dogGoingLeft) center = 2.0f * dogCenterX - localX;
+    else center = localX;
+
+    return dogX + center;
+}
+
+bool isClickAboveGround(float y) {
+    return y >= -0.8f;
+}
+
+bool isClickOnGrass(float x, float y) {
+    float grassBottom = -0.8f;
+    float grassTop = -0.55f;
+
+    if (y >= grassBottom && y <= grassTop) {
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <vector>
+#include "entities.h"
+#include "spatial_hash.h"
+#include "flow_field.h"
+#include "flock.h"
+#include "physics.h"
+#include "timer_wheel.h"
+#include "pcg.h"
+
+// Fixed-timestep simulation; rendering interpolates between the last two steps.
+const double simTimestep = 1.0 / 120.0;
+const double maxFrameTime = 0.25;
+
+enum DogState {
+    DOG_IDLE,
+    DOG_MOVING_TO_FOOD,
+    DOG_EATING,
+    DOG_RETURNING
+};
+
+enum FoodState {
+    FOOD_FREE,
+    FOOD_CLAIMED,
+    FOOD_FALLING
+};
+
+// Keys held down during a step, sampled on the main thread by processInput.
+enum InputKey {
+    INPUT_MOVE_LEFT = 1 << 0,
+    INPUT_MOVE_RIGHT = 1 << 1,
+    INPUT_PAINT_UP = 1 << 2,
+    INPUT_PAINT_DOWN = 1 << 3,
+    INPUT_TOGGLE_NIGHT = 1 << 4,
+    INPUT_SHOW_CHARACTER = 1 << 5,
+    INPUT_HIDE_CHARACTER = 1 << 6
+};
+
+// Scene-wide values the renderer interpolates between two simulation steps.
+// Per-entity positions are interpolated from the pools' prev/pos arrays.
+struct RenderState {
+    float sunX;
+    float sunY;
+    float moonX;
+    float moonY;
+    float skyColor[3];
+    float time;
+};
+
+// Copy of a world published after a simulation step.
+// The render thread only ever reads these, never the live world.
+struct SceneSnapshot {
+    RenderState previous;
+    RenderState current;
+    double publishTime;
+    // newest live input applied by the steps in this snapshot: bumps by one per
+    // input, time is when it happened (for --latency)
+    unsigned int inputSerial;
+    double inputTime;
+    // step time of the newest step that changed the scene beyond the ambient
+    // animation; the renderer idles once it has drawn that step in full
+    double changeTime;
+    bool isDay;
+    bool transparencyEnabled;
+    bool lightEnabled;
+    int selectedRoom;
+    float paintProgress;
+    float sunMoonProgress;
+
+    std::vector<float> dogPrevX;
+    std::vector<float> dogPrevY;
+    std::vector<float> dogX;
+    std::vector<float> dogY;
+    std::vector<unsigned char> dogSprite;
+    std::vector<float> foodX;
+    std::vector<float> foodPrevY;
+    std::vector<float> foodY;
+    std::vector<float> zX;
+    std::vector<float> zY;
+    std::vector<float> zStartTime;
+    std::vector<float> smokeX;
+    std::vector<float> smokeY;
+    std::vector<float> birdPrevX;
+    std::vector<float> birdPrevY;
+    std::vector<float> birdX;
+    std::vector<float> birdY;
+};
+
+// One self-contained scene: every piece of simulation state lives here, so a
+// process can hold and step any number of worlds independently. Randomness
+// comes from the world's own seeded generator, never from rand().
+class World {
+public:
+    World(int dogCount, unsigned int seed, int birdCount = 0);
+    ~World();
+    World(const World&) = delete;
+    World& operator=(const World&) = delete;
+
+    // Rebuild the food flow field on a worker thread instead of inside step().
+    // Dogs keep following the previous field until the new one lands, a fixed
+    // number of steps after it was requested.
+    void buildFlowFieldInBackground();
+    // Lets step() split its parallel passes across jobs; null runs them inline.
+    void setJobSystem(JobSystem* jobs) { this->jobs = jobs; }
+
+    // Advances the world by one fixed step with the given held keys.
+    void step(float dt, unsigned int keys);
+    // Drops a food item at (x, y); it falls to the grass before dogs can see it.
+    // Any number can be out at once.
+    void spawnFood(float x, float y);
+
+    // False if the last step changed nothing on screen beyond the ambient
+    // animation (smoke, sun glow, window light), which runs off the time alone.
+    bool sceneChanged() const { return changed; }
+
+    RenderState renderState() const;
+    void fillSnapshot(SceneSnapshot& snapshot) const;
+
+    double time() const { return simTime; }
+    bool day() const { return isDay; }
+    size_t agentCount() const { return dogs.size() + birds.size(); }
+    // dog contact candidates left untested over the broadphase budget, all steps so far
+    size_t skippedDogContacts() const { return skippedContacts; }
+
+    // print food/day-night events to stdout (the interactive world only)
+    bool logEvents;
+
+    // Entity pools. Dog 0 is the one steered with A/D.
+    EntityPool dogs;
+    EntityPool foods;
+    EntityPool zLetters;
+    EntityPool smokes;
+    Flock birds;
+
+private:
+    bool claimFoodInReach(size_t dog);
+    void followFlowField(size_t dog, float dt);
+    void rebuildFlowField();
+    void landFood(size_t food);
+    void updateFallingFood(float dt);
+    void separateDogs();
+    bool dogsMoved() const;
+
+    void applyInput(unsigned int keys, float dt);
+    void runTimers();
+    void updateDayNight();
+    void spawnZLetters();
+    void animateDogs(float dt);
+    bool resumeDog(size_t dog, float dt);
+    void wakeDog(size_t dog);
+    bool walkDogTo(size_t dog, float targetCenterX, float dt);
+    void calculateSunMoonPosition(float progress, float& sunX, float& sunY, float& moonX, float& moonY) const;
+    int randomInt(int n);
+
+    // unclaimed food only; a dog that claims an item takes it out of the grid
+    SpatialHash freeFood;
+    // steers hungry dogs toward the nearest unclaimed food; rebuilt when that set changes
+    FlowField foodField;
+    FlowFieldWorker* foodFieldWorker;
+    JobSystem* jobs;
+    bool freeFoodChanged;
+    double lastFieldBuildTime;
+    std::vector<EntityId> fallingFood;
+    // one tick per step; the day/night flip, Z letters and eating all run off it
+    TimerWheel timers;
+    std::vector<TimerEvent> firedTimers;
+    TimerId dayNightTimer;
+    TimerId zSpawnTimer;
+    TimerId fieldReadyTimer;
+    // Dogs whose behaviour runs this step. The rest are parked until whatever
+    // they wait on happens: idle ones on food landing, eating ones on a timer.
+    std::vector<unsigned int> awakeDogs;
+    std::vector<unsigned int> dogsWaitingForFood;
+    // dog collision scratch, reused every step
+    SweepAndPrune dogBroadphase;
+    std::vector<std::vector<BodyPair>> dogContacts;
+    std::vector<float> bodyX;
+    std::vector<float> bodyY;
+    std::vector<float> bodyMinX;
+    std::vector<float> bodyMaxX;
+    std::vector<float> bodyMinY;
+    std::vector<float> bodyMaxY;
+    std::vector<unsigned char> bodyFixedX;
+    size_t skippedContacts;
+    Pcg32 rng;
+    double simTime;
+    bool isDay;
+    bool keyPressed;
+    bool changed;
+    bool transitionInProgress;
+    bool transparencyEnabled;
+    bool lightEnabled;
+    int selectedRoom;
+    float paintProgress;
+    float dimFactor;
+    float transitionStartTime;
+    float sunMoonProgress;
+    float skyColor[3];
+};
+
+RenderState interpolateRenderState(const RenderState& a, const RenderState& b, float alpha);
+float getDogCenter(float dogX, bool dogGoingLeft);
+// Halfway between the left- and right-facing centers; doesn't move when the sprite flips.
+float getDogMidpoint(float dogX);
+bool isClickOnGrass(float x, float y);
+// On the grass or anywhere above it: somewhere food can be dropped from.
+bool isClickAboveGround(float y);
+float clip(float n, float lower, float upper);
+float lerp(float a, float b, float t);
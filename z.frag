@@ -3,15 +3,16 @@
 in vec2 TexCoord;
 in float vAlpha;
 
-out vec4 FragColor;
-
 uniform sampler2D uTexture;
 uniform vec3 uColor; // Color of the 'Z' letter
 
+// in oit_write.frag
+void writeColor(vec4 color);
+
 void main()
 {
     float alpha = texture(uTexture, TexCoord).r * vAlpha;
     if (alpha < 0.1)
         discard;
-    FragColor = vec4(uColor, alpha);
+    writeColor(vec4(uColor, alpha));
 }
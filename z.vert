@@ -2,28 +2,25 @@
 
 layout (location = 0) in vec3 aPos;       
 layout (location = 1) in vec2 aTexCoord;  
+// per letter: origin already risen by its age, and alpha
+layout (location = 2) in vec3 aInstance;
 
 uniform float uTime;
-uniform float uStartTime;
-uniform vec2 uOrigin;
+uniform float uDepth;
 
 out vec2 TexCoord;
 out float vAlpha;
 
 void main()
 {
-    float elapsed = uTime - uStartTime;
-    // Vertical movement upwards
-    float verticalOffset = elapsed * 0.05; // Adjust speed as needed
     // Horizontal wiggle
     float horizontalOffset = 0.01 * sin(uTime * 6.0 + aPos.y * 15.0);
 
     vec3 position = aPos;
     position.x += horizontalOffset;
-    position.y += verticalOffset;
-    position.xy += uOrigin;
+    position.xy += aInstance.xy;
 
-    gl_Position = vec4(position, 1.0);
+    gl_Position = vec4(position.xy, uDepth, 1.0);
     TexCoord = aTexCoord;
-    vAlpha = 1.0 - (elapsed / 3.0); 
+    vAlpha = aInstance.z;
 }